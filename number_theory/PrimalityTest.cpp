@@ -1,151 +1,5237 @@
 #include <iostream>
+#include <string>
+#include <cctype>
 #include <cstdio>
 #include <cstdlib>
 #include <ctime>
 #include <cmath>
+#include <type_traits>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <coroutine>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 using namespace std;
 
-class PrimalityTest {
+typedef unsigned __int128 uint128;
+
+// floor(sqrt(n)), the long double estimate corrected by at most a step each way
+static inline uint64_t IntegerSqrt(uint64_t n) {
+    uint64_t r = sqrtl((long double)n);
+    while ((uint128)r * r > n)
+        r--;
+    while ((uint128)(r + 1) * (r + 1) <= n)
+        r++;
+    return r;
+}
+
+// Work-stealing thread pool
+// ParallelFor(count, body) runs body(0) ... body(count - 1) and waits.
+// tasks are dealt to the workers' deques in contiguous blocks,
+// a worker pops its own deque from the back and, once empty,
+// steals from the front of the others'.
+// one ParallelFor at a time : the pool holds a single body and task count,
+// so ParallelFor must not be called from inside a body (it would wait on
+// the busy workers forever) or from two threads at once.
+class WorkStealingPool {
+private:
+    struct aDeque {
+        mutex lock;
+        deque<size_t> tasks;
+    };
+    
+    vector<thread> aThreads;
+    vector<unique_ptr<aDeque>> aDeques;
+    function<void(size_t)> aBody;
+    atomic<size_t> aRemaining{0};
+    mutex aLock;
+    condition_variable aWake, aDone;
+    uint64_t aGeneration = 0;
+    bool aStop = false;
+    
+    bool aPop(size_t self, size_t& task) {
+        aDeque& q = *aDeques[self];
+        lock_guard<mutex> guard(q.lock);
+        if (q.tasks.empty())
+            return false;
+        
+        task = q.tasks.back();
+        q.tasks.pop_back();
+        return true;
+    }
+    
+    bool aSteal(size_t self, size_t& task) {
+        for (size_t i=1; i<aDeques.size(); i++) {
+            aDeque& q = *aDeques[(self + i) % aDeques.size()];
+            lock_guard<mutex> guard(q.lock);
+            if (q.tasks.empty())
+                continue;
+            
+            task = q.tasks.front();
+            q.tasks.pop_front();
+            return true;
+        }
+        return false;
+    }
+    
+    void aWorker(size_t self) {
+        uint64_t seen = 0;
+        while (true) {
+            {
+                unique_lock<mutex> guard(aLock);
+                aWake.wait(guard, [&] { return aStop || aGeneration != seen; });
+                if (aStop)
+                    return;
+                seen = aGeneration;
+            }
+            
+            size_t task;
+            while (aPop(self, task) || aSteal(self, task)) {
+                aBody(task);
+                
+                if (--aRemaining == 0) {
+                    lock_guard<mutex> guard(aLock);
+                    aDone.notify_all();
+                }
+            }
+        }
+    }
+    
+public:
+    WorkStealingPool(unsigned threads = thread::hardware_concurrency()) {
+        threads = max(threads, 1u);
+        for (unsigned i=0; i<threads; i++)
+            aDeques.push_back(make_unique<aDeque>());
+        for (unsigned i=0; i<threads; i++)
+            aThreads.emplace_back(&WorkStealingPool::aWorker, this, i);
+    }
+    
+    ~WorkStealingPool() {
+        {
+            lock_guard<mutex> guard(aLock);
+            aStop = true;
+        }
+        aWake.notify_all();
+        for (thread& t : aThreads)
+            t.join();
+    }
+    
+    size_t Size() {
+        return aThreads.size();
+    }
+    
+    // not reentrant, see above
+    void ParallelFor(size_t count, const function<void(size_t)>& body) {
+        if (count == 0)
+            return;
+        
+        aBody = body;
+        aRemaining = count;
+        
+        size_t workers = aDeques.size();
+        for (size_t w=0; w<workers; w++) {
+            lock_guard<mutex> guard(aDeques[w]->lock);
+            for (size_t i=count*w/workers; i<count*(w+1)/workers; i++)
+                aDeques[w]->tasks.push_back(i);
+        }
+        
+        unique_lock<mutex> guard(aLock);
+        aGeneration++;
+        aWake.notify_all();
+        aDone.wait(guard, [&] { return aRemaining == 0; });
+    }
+};
+
+// SplitMix64
+// expands one 64-bit seed into well mixed words, used to seed xoshiro
+class SplitMix64 {
+private:
+    uint64_t aState;
+    
+public:
+    SplitMix64(uint64_t seed) {
+        aState = seed;
+    }
+    
+    uint64_t Next() {
+        uint64_t z = (aState += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+};
+
+// xoshiro256** (Blackman, Vigna)
+// 256-bit state, full 64-bit outputs, a few cycles per draw
+// the same seed always replays the same sequence
+class Xoshiro256 {
+private:
+    uint64_t aState[4];
+    
+    static uint64_t aRotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+    
+public:
+    Xoshiro256(uint64_t seed = 0) {
+        Seed(seed);
+    }
+    
+    void Seed(uint64_t seed) {
+        SplitMix64 sm(seed);
+        for (uint64_t& word : aState)
+            word = sm.Next();
+    }
+    
+    uint64_t Next() {
+        uint64_t result = aRotl(aState[1] * 5, 7) * 9,
+                t = aState[1] << 17;
+        
+        aState[2] ^= aState[0];
+        aState[3] ^= aState[1];
+        aState[1] ^= aState[2];
+        aState[0] ^= aState[3];
+        aState[2] ^= t;
+        aState[3] = aRotl(aState[3], 45);
+        
+        return result;
+    }
+    
+    // uniform in [0, bound), Lemire's multiply-shift without modulo bias
+    uint64_t Below(uint64_t bound) {
+        uint128 m = (uint128)Next() * bound;
+        uint64_t low = (uint64_t)m;
+        
+        if (low < bound) {
+            uint64_t threshold = (0 - bound) % bound;
+            while (low < threshold) {
+                m = (uint128)Next() * bound;
+                low = (uint64_t)m;
+            }
+        }
+        return m >> 64;
+    }
+    
+    // random odd number of exactly bits bits, 2 <= bits <= 64
+    uint64_t Odd(int bits) {
+        uint64_t top = 1ULL << (bits - 1),
+                mask = bits == 64 ? UINT64_MAX : 2 * top - 1;
+        return (Next() & mask) | top | 1;
+    }
+};
+
+// Exponentiation strategy of the Montgomery classes
+//   Binary : square and multiply, one bit at a time
+//   Window : sliding window over the precomputed odd powers base^1 ... base^(2^k - 1),
+//            about one multiply per k + 1 exponent bits instead of one per 2 bits
+//   Automatic : Binary for 64-bit moduli, whose right-to-left square and
+//            multiply chains overlap, Window for multi-limb moduli
+// every strategy but Binary raises 2 by doubling, PowTwo, not multiplying
+enum class PowStrategy { Binary, Window, Automatic };
+
+// Montgomery Form Modular Arithmetic
+// R = 2^64, n odd
+// x is stored as x*R (mod n), REDC(T) = T*R^-1 (mod n)
+// REDC only needs multiplies and a subtraction, no hardware division
+class Montgomery64 {
+public:
+    typedef uint64_t Value;
+    
+private:
+    uint64_t aMod;
+    uint64_t aInv;  // n^-1 (mod 2^64)
+    uint64_t aOne;  // R (mod n)
+    uint64_t aR2;   // R^2 (mod n)
+    PowStrategy aStrategy = PowStrategy::Automatic;
+    
+    // window width k of PowWindow
+    static const int aWindowBits = 4;
+    
+    // m = T*n^-1 (mod R), T - m*n ≡ 0 (mod R)
+    // (T - m*n) / R = hi(T) - hi(m*n), in (-n, n)
+    constexpr uint64_t aREDC(uint128 t) const {
+        uint64_t m = (uint64_t)t * aInv;
+        uint64_t th = t >> 64,
+                mh = ((uint128)m * aMod) >> 64;
+        
+        return th >= mh ? th - mh : th - mh + aMod;
+    }
+    
+public:
+    constexpr Montgomery64(uint64_t modulus) {
+        aMod = modulus;
+        
+        // Newton's iteration, each step doubles the correct low bits
+        // n*n ≡ 1 (mod 8) : 3 -> 6 -> 12 -> 24 -> 48 -> 96
+        aInv = modulus;
+        for (int i=0; i<5; i++)
+            aInv *= 2 - modulus * aInv;
+        
+        aOne = (0 - modulus) % modulus;
+        aR2 = (uint128)aOne * aOne % modulus;
+    }
+    
+    constexpr uint64_t Modulus() const {
+        return aMod;
+    }
+    
+    constexpr uint64_t One() const {
+        return aOne;
+    }
+    
+    constexpr void SetStrategy(PowStrategy strategy) {
+        aStrategy = strategy;
+    }
+    
+    constexpr PowStrategy Strategy() const {
+        return aStrategy;
+    }
+    
+    constexpr uint64_t ToMont(uint64_t x) const {
+        return aREDC((uint128)x * aR2);
+    }
+    
+    constexpr uint64_t FromMont(uint64_t x) const {
+        return aREDC(x);
+    }
+    
+    constexpr uint64_t Mul(uint64_t a, uint64_t b) const {
+        return aREDC((uint128)a * b);
+    }
+    
+    constexpr uint64_t Add(uint64_t a, uint64_t b) const {
+        return a >= aMod - b ? a - (aMod - b) : a + b;
+    }
+    
+    constexpr uint64_t Sub(uint64_t a, uint64_t b) const {
+        return a >= b ? a - b : a - b + aMod;
+    }
+    
+    // x / 2 (mod n), n odd
+    // x odd : (x + n) / 2 without overflowing x + n
+    constexpr uint64_t Half(uint64_t x) const {
+        return (x & 1) ? (x >> 1) + (aMod >> 1) + 1 : x >> 1;
+    }
+    
+    // base in Montgomery form, result in Montgomery form
+    constexpr uint64_t Pow(uint64_t base, uint64_t exponent) const {
+        if (aStrategy == PowStrategy::Window)
+            return PowWindow(base, exponent);
+        
+        uint64_t result = aOne;
+        while (exponent > 0) {
+            if (exponent & 1)
+                result = Mul(result, base);
+            
+            base = Mul(base, base);
+            
+            exponent >>= 1;
+        }
+        return result;
+    }
+    
+    // left-to-right sliding window, the window ends on a set bit
+    constexpr uint64_t PowWindow(uint64_t base, uint64_t exponent) const {
+        uint64_t odd[1 << (aWindowBits - 1)] = {base},
+                square = Mul(base, base);
+        for (int i=1; i<(1 << (aWindowBits - 1)); i++)
+            odd[i] = Mul(odd[i - 1], square);
+        
+        uint64_t result = aOne;
+        for (int i=63 - __builtin_clzll(exponent | 1); i>=0; ) {
+            if (((exponent >> i) & 1) == 0) {
+                result = Mul(result, result);
+                i--;
+                continue;
+            }
+            
+            int j = max(i - aWindowBits + 1, 0);
+            while (((exponent >> j) & 1) == 0)
+                j++;
+            
+            for (int k=j; k<=i; k++)
+                result = Mul(result, result);
+            result = Mul(result, odd[((exponent >> j) & ((1ULL << (i - j + 1)) - 1)) >> 1]);
+            i = j - 1;
+        }
+        return exponent ? result : aOne;
+    }
+    
+    // 2^exponent in Montgomery form, the multiply by 2 is an Add
+    constexpr uint64_t PowTwo(uint64_t exponent) const {
+        uint64_t result = aOne;
+        for (int i=63 - __builtin_clzll(exponent | 1); i>=0; i--) {
+            result = Mul(result, result);
+            if ((exponent >> i) & 1)
+                result = Add(result, result);
+        }
+        return result;
+    }
+};
+
+// Small prime table, built at compile time
+// odd primes below 1024 with p^-1 (mod 2^64) and (2^64 - 1) / p,
+// p | n  <=>  n * p^-1 (mod 2^64) <= (2^64 - 1) / p, no division
+struct SmallPrimeTable {
+    int count = 0;
+    uint64_t prime[172] = {}, inverse[172] = {}, limit[172] = {};
+    
+    constexpr SmallPrimeTable() {
+        for (uint64_t p=3; p<1024; p+=2) {
+            bool isPrime = true;
+            for (uint64_t q=3; q*q<=p; q+=2)
+                isPrime = isPrime && p%q != 0;
+            if (!isPrime)
+                continue;
+            
+            uint64_t inv = p;
+            for (int i=0; i<5; i++)
+                inv *= 2 - p * inv;
+            
+            prime[count] = p;
+            inverse[count] = inv;
+            limit[count] = UINT64_MAX / p;
+            count++;
+        }
+    }
+};
+
+// Odd primes below 2^16 as a bitmap, bit (n - 1) / 2
+// sieved at compile time, 4 KiB
+struct SmallPrimeBitmap {
+    static const uint64_t limit = 1 << 16;
+    uint64_t word[limit / 128] = {};
+    
+    constexpr SmallPrimeBitmap() {
+        for (uint64_t i=0; i<limit/128; i++)
+            word[i] = UINT64_MAX;
+        word[0] &= ~1ULL;
+        
+        for (uint64_t p=3; p*p<limit; p+=2) {
+            if (!Test(p))
+                continue;
+            for (uint64_t m=p*p; m<limit; m+=2*p)
+                word[m / 128] &= ~(1ULL << (m / 2 % 64));
+        }
+    }
+    
+    // n odd, n < limit
+    constexpr bool Test(uint64_t n) const {
+        return (word[n / 128] >> (n / 2 % 64)) & 1;
+    }
+};
+
+// Hot-path counters, compiled in with -DPRIMALITY_STATS
+// every thread bumps its own block with relaxed load + store, nothing is shared
+// on the hot path, Read() sums the blocks of all threads, live or exited.
+// without the macro PRIMALITY_COUNT and PRIMALITY_TIME expand to nothing.
+class PrimalityStats {
+public:
+    enum Counter {
+        FilterTrial,    // composite at the parity / trial division stage
+        FilterGcd,      // composite at the primorial GCD stage
+        FilterPrime,    // proven prime by the filter
+        FilterPassed,   // left for the probabilistic stages
+        ModExp,         // modular exponentiations
+        Lucas,          // strong Lucas sequences
+        Division,       // trial divisions
+        CacheHit,       // VerdictCache lookups found
+        CacheMiss,      // VerdictCache lookups missed
+        Counters
+    };
+    
+    enum Method {
+        Simple, SimpleOptimize, Wilson, Fermat, StrongFermat, SolovayStrassen,
+        MillerRabin, BailliePSW, Dispatch, Batch, Factorize, Methods
+    };
+    
+    // histogram bucket b : calls taking [2^b, 2^(b+1)) ns
+    static const int Buckets = 32;
+    
+    struct Snapshot {
+        uint64_t counter[Counters] = {};
+        uint64_t calls[Methods] = {};
+        uint64_t histogram[Methods][Buckets] = {};
+        
+        void Print() const {
+            static const char* counters[] = {"filter trial", "filter gcd", "filter prime",
+                    "filter passed", "modexp", "lucas", "division", "cache hit", "cache miss"};
+            static const char* methods[] = {"Simple", "SimpleOptimize", "Wilson", "Fermat",
+                    "StrongFermat", "SolovayStrassen", "MillerRabin", "BailliePSW", "IsPrime",
+                    "Batch", "Factorize"};
+            
+            for (int c=0; c<Counters; c++)
+                printf("%-16s %14llu\n", counters[c], (unsigned long long)counter[c]);
+            
+            for (int m=0; m<Methods; m++) {
+                if (calls[m] == 0)
+                    continue;
+                printf("%-16s %14llu calls, ns:", methods[m], (unsigned long long)calls[m]);
+                for (int b=0; b<Buckets; b++) {
+                    if (histogram[m][b])
+                        printf(" <2^%d:%llu", b + 1, (unsigned long long)histogram[m][b]);
+                }
+                printf("\n");
+            }
+        }
+    };
+    
+private:
+    struct aBlock {
+        atomic<uint64_t> counter[Counters];
+        atomic<uint64_t> histogram[Methods][Buckets];
+    };
+    
+    // blocks outlive their threads so nothing is lost on exit
+    static mutex& aLock() {
+        static mutex lock;
+        return lock;
+    }
+    
+    static vector<unique_ptr<aBlock>>& aBlocks() {
+        static vector<unique_ptr<aBlock>> blocks;
+        return blocks;
+    }
+    
+    static aBlock& aLocal() {
+        thread_local aBlock* block = [] {
+            lock_guard<mutex> guard(aLock());
+            aBlocks().push_back(make_unique<aBlock>());
+            return aBlocks().back().get();
+        }();
+        return *block;
+    }
+    
+    // single writer, a plain add without a locked instruction
+    static void aBump(atomic<uint64_t>& x, uint64_t k) {
+        x.store(x.load(memory_order_relaxed) + k, memory_order_relaxed);
+    }
+    
+public:
+    static void Add(Counter c, uint64_t k = 1) {
+        aBump(aLocal().counter[c], k);
+    }
+    
+    static void Record(Method m, uint64_t ns) {
+        int b = ns ? min(63 - __builtin_clzll(ns), Buckets - 1) : 0;
+        aBump(aLocal().histogram[m][b], 1);
+    }
+    
+    // times the enclosing scope
+    class Timer {
+    private:
+        Method aMethod;
+        chrono::steady_clock::time_point aStart;
+        
+    public:
+        Timer(Method m) : aMethod(m), aStart(chrono::steady_clock::now()) {}
+        
+        ~Timer() {
+            auto ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - aStart).count();
+            Record(aMethod, ns);
+        }
+    };
+    
+    static Snapshot Read() {
+        lock_guard<mutex> guard(aLock());
+        Snapshot snapshot;
+        for (const unique_ptr<aBlock>& block : aBlocks()) {
+            for (int c=0; c<Counters; c++)
+                snapshot.counter[c] += block->counter[c].load(memory_order_relaxed);
+            for (int m=0; m<Methods; m++) {
+                for (int b=0; b<Buckets; b++) {
+                    uint64_t k = block->histogram[m][b].load(memory_order_relaxed);
+                    snapshot.histogram[m][b] += k;
+                    snapshot.calls[m] += k;
+                }
+            }
+        }
+        return snapshot;
+    }
+    
+    // a thread counting meanwhile may keep one of its increments
+    static void Reset() {
+        lock_guard<mutex> guard(aLock());
+        for (const unique_ptr<aBlock>& block : aBlocks()) {
+            for (int c=0; c<Counters; c++)
+                block->counter[c].store(0, memory_order_relaxed);
+            for (int m=0; m<Methods; m++) {
+                for (int b=0; b<Buckets; b++)
+                    block->histogram[m][b].store(0, memory_order_relaxed);
+            }
+        }
+    }
+};
+
+// constant evaluation never counts
+#if defined(PRIMALITY_STATS)
+#define PRIMALITY_COUNT(counter, k) \
+    do { if (!is_constant_evaluated()) PrimalityStats::Add(PrimalityStats::counter, k); } while (0)
+#define PRIMALITY_TIME(method) PrimalityStats::Timer aTimer(PrimalityStats::method)
+#else
+#define PRIMALITY_COUNT(counter, k) ((void)0)
+#define PRIMALITY_TIME(method) ((void)0)
+#endif
+
+// Fixed-width unsigned integer
+// LIMBS 64-bit limbs, least significant first, arithmetic wraps mod 2^(64 LIMBS)
+// BigUInt<2> is 128 bits, BigUInt<32> is 2048 bits
+template<int LIMBS>
+class BigUInt {
+public:
+    uint64_t limb[LIMBS] = {};
+    
+    BigUInt(uint64_t x = 0) {
+        limb[0] = x;
+    }
+    
+    // decimal, or hexadecimal with a 0x prefix
+    static BigUInt FromString(const string& text) {
+        BigUInt x;
+        bool hex = text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X');
+        for (size_t i=hex ? 2 : 0; i<text.size(); i++) {
+            char c = text[i];
+            int digit = isdigit(c) ? c - '0' : isxdigit(c) ? tolower(c) - 'a' + 10 : -1;
+            if (digit < 0 || (!hex && digit > 9))
+                break;
+            x.aMulAdd(hex ? 16 : 10, digit);
+        }
+        return x;
+    }
+    
+    string ToString() const {
+        if (IsZero())
+            return "0";
+        
+        // peel 19 decimal digits at a time
+        BigUInt x = *this;
+        string text;
+        while (!x.IsZero()) {
+            uint64_t r = x.aDivSmall(10000000000000000000ULL);
+            for (int i=0; i<19 && (r != 0 || !x.IsZero()); i++) {
+                text += char('0' + r % 10);
+                r /= 10;
+            }
+        }
+        return string(text.rbegin(), text.rend());
+    }
+    
+    bool IsZero() const {
+        for (int i=0; i<LIMBS; i++) {
+            if (limb[i])
+                return false;
+        }
+        return true;
+    }
+    
+    bool IsOdd() const {
+        return limb[0] & 1;
+    }
+    
+    bool FitsUInt64() const {
+        for (int i=1; i<LIMBS; i++) {
+            if (limb[i])
+                return false;
+        }
+        return true;
+    }
+    
+    int BitLength() const {
+        for (int i=LIMBS-1; i>=0; i--) {
+            if (limb[i])
+                return 64 * i + 64 - __builtin_clzll(limb[i]);
+        }
+        return 0;
+    }
+    
+    bool Bit(int i) const {
+        return (limb[i / 64] >> (i % 64)) & 1;
+    }
+    
+    void SetBit(int i) {
+        limb[i / 64] |= 1ULL << (i % 64);
+    }
+    
+    int TrailingZeros() const {
+        for (int i=0; i<LIMBS; i++) {
+            if (limb[i])
+                return 64 * i + __builtin_ctzll(limb[i]);
+        }
+        return 64 * LIMBS;
+    }
+    
+    // this mod m by one 128/64 division per limb
+    uint64_t ModSmall(uint64_t m) const {
+        uint128 r = 0;
+        for (int i=LIMBS-1; i>=0; i--)
+            r = ((r << 64) | limb[i]) % m;
+        return r;
+    }
+    
+    bool operator== (const BigUInt& o) const {
+        for (int i=0; i<LIMBS; i++) {
+            if (limb[i] != o.limb[i])
+                return false;
+        }
+        return true;
+    }
+    
+    bool operator!= (const BigUInt& o) const {
+        return !(*this == o);
+    }
+    
+    bool operator< (const BigUInt& o) const {
+        for (int i=LIMBS-1; i>=0; i--) {
+            if (limb[i] != o.limb[i])
+                return limb[i] < o.limb[i];
+        }
+        return false;
+    }
+    
+    bool operator>= (const BigUInt& o) const {
+        return !(*this < o);
+    }
+    
+    BigUInt operator+ (const BigUInt& o) const {
+        BigUInt r;
+        uint64_t carry = 0;
+        for (int i=0; i<LIMBS; i++) {
+            uint128 s = (uint128)limb[i] + o.limb[i] + carry;
+            r.limb[i] = s;
+            carry = s >> 64;
+        }
+        return r;
+    }
+    
+    BigUInt operator- (const BigUInt& o) const {
+        BigUInt r;
+        uint64_t borrow = 0;
+        for (int i=0; i<LIMBS; i++) {
+            uint128 d = (uint128)limb[i] - o.limb[i] - borrow;
+            r.limb[i] = d;
+            borrow = (d >> 64) & 1;
+        }
+        return r;
+    }
+    
+    BigUInt operator>> (int k) const {
+        BigUInt r;
+        int words = k / 64, bits = k % 64;
+        for (int i=0; i+words<LIMBS; i++) {
+            r.limb[i] = limb[i + words] >> bits;
+            if (bits && i + words + 1 < LIMBS)
+                r.limb[i] |= limb[i + words + 1] << (64 - bits);
+        }
+        return r;
+    }
+    
+    // this = this * m + a
+    void aMulAdd(uint64_t m, uint64_t a) {
+        uint64_t carry = a;
+        for (int i=0; i<LIMBS; i++) {
+            uint128 t = (uint128)limb[i] * m + carry;
+            limb[i] = t;
+            carry = t >> 64;
+        }
+    }
+    
+    // this = this / m, returns the remainder
+    uint64_t aDivSmall(uint64_t m) {
+        uint128 r = 0;
+        for (int i=LIMBS-1; i>=0; i--) {
+            r = (r << 64) | limb[i];
+            limb[i] = r / m;
+            r %= m;
+        }
+        return r;
+    }
+};
+
+// Limb array multiplication
+// out[0, 2n) = a[0, n) * b[0, n)
+// schoolbook O(n^2) below aKaratsubaThreshold limbs,
+// Karatsuba above : a = a1*B^m + a0, b = b1*B^m + b0
+// a*b = z2*B^2m + ((a0 + a1)(b0 + b1) - z0 - z2)*B^m + z0, 3 half-size products.
+// the widths built here, at most 16 limbs, stay schoolbook,
+// --verify runs the Karatsuba path on its own
+class LimbMultiply {
 private:
-    long long aN;
+    static const int aKaratsubaThreshold = 48;
+    
+    // r[0, n) += x[0, k), k <= n, returns the carry out of r
+    static uint64_t aAdd(uint64_t* r, const uint64_t* x, int k, int n) {
+        uint64_t carry = 0;
+        for (int i=0; i<n && (i<k || carry); i++) {
+            uint128 s = (uint128)r[i] + (i < k ? x[i] : 0) + carry;
+            r[i] = s;
+            carry = s >> 64;
+        }
+        return carry;
+    }
+    
+    // r[0, n) -= x[0, k), k <= n
+    static void aSub(uint64_t* r, const uint64_t* x, int k, int n) {
+        uint64_t borrow = 0;
+        for (int i=0; i<n && (i<k || borrow); i++) {
+            uint128 d = (uint128)r[i] - (i < k ? x[i] : 0) - borrow;
+            r[i] = d;
+            borrow = (d >> 64) & 1;
+        }
+    }
+    
+public:
+    // the O(n^2) product, reference for the Karatsuba path
+    static void Schoolbook(const uint64_t* a, const uint64_t* b, int n, uint64_t* out) {
+        fill(out, out + 2 * n, 0);
+        for (int i=0; i<n; i++) {
+            uint64_t carry = 0;
+            for (int j=0; j<n; j++) {
+                uint128 t = (uint128)a[i] * b[j] + out[i + j] + carry;
+                out[i + j] = t;
+                carry = t >> 64;
+            }
+            out[i + n] = carry;
+        }
+    }
+    
+    // scratch limbs Mul needs for n-limb operands
+    static constexpr int ScratchLimbs(int n) {
+        int total = 0;
+        while (n >= aKaratsubaThreshold) {
+            int h = n - n / 2;
+            total += 4 * (h + 1);
+            n = h + 1;
+        }
+        return total + 1;
+    }
+    
+    static void Mul(const uint64_t* a, const uint64_t* b, int n, uint64_t* out, uint64_t* scratch) {
+        if (n < aKaratsubaThreshold)
+            return Schoolbook(a, b, n, out);
+        
+        int m = n / 2, h = n - m;
+        uint64_t* sa = scratch;
+        uint64_t* sb = scratch + (h + 1);
+        uint64_t* mid = scratch + 2 * (h + 1);
+        
+        Mul(a, b, m, out, scratch + 4 * (h + 1));
+        Mul(a + m, b + m, h, out + 2 * m, scratch + 4 * (h + 1));
+        
+        // (a0 + a1) and (b0 + b1) in h + 1 limbs, m <= h
+        copy(a + m, a + n, sa);
+        copy(b + m, b + n, sb);
+        sa[h] = aAdd(sa, a, m, h);
+        sb[h] = aAdd(sb, b, m, h);
+        
+        Mul(sa, sb, h + 1, mid, scratch + 4 * (h + 1));
+        aSub(mid, out, 2 * m, 2 * (h + 1));
+        aSub(mid, out + 2 * m, 2 * h, 2 * (h + 1));
+        
+        // the middle term fits below limb 2n, higher limbs of mid are 0
+        aAdd(out + m, mid, min(2 * (h + 1), 2 * n - m), 2 * n - m);
+    }
+};
+
+// Multi-limb Montgomery arithmetic, R = 2^(64 LIMBS), n odd
+// same interface as Montgomery64, products go through LimbMultiply
+// and are reduced limb by limb (separated operand scanning).
+// Karatsuba scratch lives on the stack of each Mul, so one context can be
+// shared by any number of threads through its const methods
+template<int LIMBS>
+class MontgomeryBig {
+public:
+    typedef BigUInt<LIMBS> Value;
+    
+private:
+    Value aMod;
+    Value aOne;     // R (mod n)
+    Value aR2;      // R^2 (mod n)
+    uint64_t aInv;  // -n^-1 (mod 2^64)
+    PowStrategy aStrategy = PowStrategy::Automatic;
+    
+    // window width k for a bits-bit exponent, 2^(k-1) stored odd powers
+    static int aWindowBits(int bits) {
+        return bits <= 64 ? 3 : bits <= 256 ? 4 : bits <= 768 ? 5 : 6;
+    }
+    
+    // x = 2x (mod n), x < n
+    Value aDouble(const Value& x) const {
+        bool carry = x.limb[LIMBS - 1] >> 63;
+        Value r = x + x;
+        return (carry || r >= aMod) ? r - aMod : r;
+    }
+    
+    // t[0, 2 LIMBS] holds T < n*R, returns T * R^-1 (mod n)
+    Value aREDC(uint64_t* t) const {
+        for (int i=0; i<LIMBS; i++) {
+            uint64_t m = t[i] * aInv,
+                    carry = 0;
+            for (int j=0; j<LIMBS; j++) {
+                uint128 s = (uint128)m * aMod.limb[j] + t[i + j] + carry;
+                t[i + j] = s;
+                carry = s >> 64;
+            }
+            for (int k=i+LIMBS; carry && k<=2*LIMBS; k++) {
+                uint128 s = (uint128)t[k] + carry;
+                t[k] = s;
+                carry = s >> 64;
+            }
+        }
+        
+        Value r;
+        copy(t + LIMBS, t + 2 * LIMBS, r.limb);
+        return (t[2 * LIMBS] || r >= aMod) ? r - aMod : r;
+    }
+    
+public:
+    MontgomeryBig(const Value& modulus) : aMod(modulus) {
+        uint64_t n0 = modulus.limb[0],
+                inv = n0;
+        for (int i=0; i<5; i++)
+            inv *= 2 - n0 * inv;
+        aInv = 0 - inv;
+        
+        // R and R^2 (mod n) by doubling, no long division needed
+        Value x = Value(1) >= aMod ? Value(0) : Value(1);
+        for (int i=0; i<64*LIMBS; i++)
+            x = aDouble(x);
+        aOne = x;
+        for (int i=0; i<64*LIMBS; i++)
+            x = aDouble(x);
+        aR2 = x;
+    }
+    
+    const Value& Modulus() const {
+        return aMod;
+    }
+    
+    Value One() const {
+        return aOne;
+    }
+    
+    void SetStrategy(PowStrategy strategy) {
+        aStrategy = strategy;
+    }
+    
+    PowStrategy Strategy() const {
+        return aStrategy;
+    }
+    
+    Value ToMont(const Value& x) const {
+        return Mul(x, aR2);
+    }
+    
+    Value FromMont(const Value& x) const {
+        uint64_t t[2 * LIMBS + 1] = {};
+        copy(x.limb, x.limb + LIMBS, t);
+        return aREDC(t);
+    }
+    
+    Value Mul(const Value& a, const Value& b) const {
+        uint64_t t[2 * LIMBS + 1],
+                scratch[LimbMultiply::ScratchLimbs(LIMBS)];
+        LimbMultiply::Mul(a.limb, b.limb, LIMBS, t, scratch);
+        t[2 * LIMBS] = 0;
+        return aREDC(t);
+    }
+    
+    Value Add(const Value& a, const Value& b) const {
+        Value r = a + b;
+        bool carry = r < a;
+        return (carry || r >= aMod) ? r - aMod : r;
+    }
+    
+    Value Sub(const Value& a, const Value& b) const {
+        return a >= b ? a - b : a - b + aMod;
+    }
+    
+    Value Half(const Value& x) const {
+        if (!x.IsOdd())
+            return x >> 1;
+        
+        // (x + n) / 2 = x/2 + n/2 + 1 for odd x and n
+        return (x >> 1) + (aMod >> 1) + Value(1);
+    }
+    
+    // base and result in Montgomery form
+    Value Pow(const Value& base, const Value& exponent) const {
+        if (aStrategy != PowStrategy::Binary)
+            return PowWindow(base, exponent);
+        
+        // left-to-right binary exponentiation
+        Value result = aOne;
+        for (int i=exponent.BitLength()-1; i>=0; i--) {
+            result = Mul(result, result);
+            if (exponent.Bit(i))
+                result = Mul(result, base);
+        }
+        return result;
+    }
+    
+    // left-to-right sliding window, the window ends on a set bit
+    Value PowWindow(const Value& base, const Value& exponent) const {
+        int bits = exponent.BitLength(),
+                width = aWindowBits(bits);
+        Value odd[32] = {base},
+                square = Mul(base, base);
+        for (int i=1; i<(1 << (width - 1)); i++)
+            odd[i] = Mul(odd[i - 1], square);
+        
+        Value result = aOne;
+        for (int i=bits-1; i>=0; ) {
+            if (!exponent.Bit(i)) {
+                result = Mul(result, result);
+                i--;
+                continue;
+            }
+            
+            int j = max(i - width + 1, 0);
+            while (!exponent.Bit(j))
+                j++;
+            
+            int window = 0;
+            for (int k=i; k>=j; k--) {
+                result = Mul(result, result);
+                window = 2 * window + exponent.Bit(k);
+            }
+            result = Mul(result, odd[window >> 1]);
+            i = j - 1;
+        }
+        return result;
+    }
+    
+    // 2^exponent in Montgomery form, the multiply by 2 is an Add
+    Value PowTwo(const Value& exponent) const {
+        Value result = aOne;
+        for (int i=exponent.BitLength()-1; i>=0; i--) {
+            result = Mul(result, result);
+            if (exponent.Bit(i))
+                result = Add(result, result);
+        }
+        return result;
+    }
+};
+
+// Prime table, the first primes in about 1.1 bytes each
+// half gaps (p[i+1] - p[i]) / 2 in one byte each, enough up to 304599508537
+// (~3.05*10^11) followed by 514, the first gap above 510, and every
+// aStride-th prime absolute. Push fails from that prime on, the table
+// then ends there and a caller asking for more primes gets fewer.
+// Nth walks at most aStride - 1 gaps from a sample, Index is a binary
+// search over the samples and the same walk, neither allocates.
+// filled in increasing order by Push, see SegmentedSieve::Table
+class PrimeTable {
+private:
+    static const uint64_t aStride = 64;
+    
+    vector<uint8_t> aGaps;      // aGaps[i] : p[i] -> p[i+1], 2 -> 3 stored as 1, last 0
+    vector<uint64_t> aSamples;  // aSamples[k] = p[k * aStride]
+    uint64_t aLast = 0;
+    
+    // 2 + 2*1 - 1 = 3, every other step is 2 * gap
+    static uint64_t aStep(uint64_t p, uint8_t gap) {
+        return p + 2 * gap - (p == 2);
+    }
+    
+public:
+    class Iterator {
+    private:
+        const uint8_t* aGap;
+        uint64_t aPrime;
+        
+    public:
+        Iterator(const uint8_t* gap, uint64_t prime) : aGap(gap), aPrime(prime) {}
+        
+        uint64_t operator*() const {
+            return aPrime;
+        }
+        
+        Iterator& operator++() {
+            aPrime = aStep(aPrime, *aGap++);
+            return *this;
+        }
+        
+        bool operator!=(const Iterator& other) const {
+            return aGap != other.aGap;
+        }
+    };
+    
+    void Clear() {
+        aGaps.clear();
+        aSamples.clear();
+        aLast = 0;
+    }
+    
+    void Reserve(uint64_t count) {
+        aGaps.reserve(count);
+        aSamples.reserve(count / aStride + 1);
+    }
+    
+    // p the next prime after Last(), false if the gap does not fit a byte
+    bool Push(uint64_t p) {
+        if (!aGaps.empty()) {
+            uint64_t gap = (p - aLast + 1) / 2;
+            if (gap > 255)
+                return false;
+            aGaps.back() = gap;
+        }
+        
+        if (Size() % aStride == 0)
+            aSamples.push_back(p);
+        aGaps.push_back(0);
+        aLast = p;
+        return true;
+    }
+    
+    uint64_t Size() const {
+        return aGaps.size();
+    }
+    
+    // largest prime held, 0 if empty
+    uint64_t Last() const {
+        return aLast;
+    }
+    
+    // i-th prime, Nth(0) = 2, i < Size()
+    uint64_t Nth(uint64_t i) const {
+        uint64_t p = aSamples[i / aStride];
+        for (uint64_t k=i-i%aStride; k<i; k++)
+            p = aStep(p, aGaps[k]);
+        return p;
+    }
+    
+    // number of held primes <= x, pi(x) for x <= Last()
+    uint64_t Index(uint64_t x) const {
+        uint64_t block = upper_bound(aSamples.begin(), aSamples.end(), x) - aSamples.begin();
+        if (block == 0)
+            return 0;
+        
+        uint64_t i = (block - 1) * aStride,
+                p = aSamples[block - 1];
+        while (i + 1 < Size() && aStep(p, aGaps[i]) <= x)
+            p = aStep(p, aGaps[i++]);
+        return i + 1;
+    }
+    
+    // stepping off the last prime reads the trailing 0
+    Iterator begin() const {
+        return Iterator(aGaps.data(), aSamples.empty() ? 0 : aSamples[0]);
+    }
+    
+    Iterator end() const {
+        return Iterator(aGaps.data() + Size(), 0);
+    }
+};
+
+// Smallest prime factor table, linear sieve below limit <= 2^32
+// odd n only, entry n / 2, and 16 bits each : a composite n < 2^32 has
+// spf(n) <= sqrt(n) < 2^16 and 0 marks a prime, limit bytes in all,
+// a quarter of a plain uint32 table. every composite m * p, p <= spf(m),
+// is written exactly once with its smallest factor p.
+// FactorizeSmall is then one lookup and one division per prime factor
+class FactorTable {
+private:
+    vector<uint16_t> aSpf;      // aSpf[n / 2] = spf(n) for odd composite n, 0 otherwise
+    uint64_t aLimit = 0;
+    
+public:
+    // false if limit > 2^32
+    bool Build(uint64_t limit) {
+        if (limit > (uint64_t(1) << 32))
+            return false;
+        
+        aLimit = limit;
+        aSpf.assign((limit + 1) / 2, 0);
+        
+        // only primes p <= limit / 3 have a multiple m * p below the limit
+        vector<uint32_t> primes;
+        for (uint64_t i=1; i<aSpf.size(); i++) {
+            uint64_t m = 2 * i + 1,
+                    f = aSpf[i] ? aSpf[i] : m;
+            if (f == m && 3 * m < limit)
+                primes.push_back(m);
+            
+            for (uint32_t p : primes) {
+                if (p > f || m * p >= limit)
+                    break;
+                aSpf[m * p / 2] = p;
+            }
+        }
+        return true;
+    }
+    
+    // covered numbers are n < Limit()
+    uint64_t Limit() const {
+        return aLimit;
+    }
+    
+    // smallest prime factor of 2 <= n < Limit()
+    uint64_t SmallestFactor(uint64_t n) const {
+        if (n % 2 == 0)
+            return 2;
+        return aSpf[n / 2] ? aSpf[n / 2] : n;
+    }
+    
+    // prime factors of 1 <= n < Limit() in increasing order, with multiplicity,
+    // appended to factors so bulk callers can reuse one vector
+    void FactorizeSmall(uint64_t n, vector<uint64_t>& factors) const {
+        for (int k=__builtin_ctzll(n); k>0; k--)
+            factors.push_back(2);
+        n >>= __builtin_ctzll(n);
+        
+        while (n > 1) {
+            uint64_t p = aSpf[n / 2];
+            if (p == 0) {
+                factors.push_back(n);
+                return;
+            }
+            factors.push_back(p);
+            n /= p;
+        }
+    }
+    
+    vector<uint64_t> FactorizeSmall(uint64_t n) const {
+        vector<uint64_t> factors;
+        FactorizeSmall(n, factors);
+        return factors;
+    }
+};
+
+class PrimalityTest {
+private:
+    uint64_t aN;
+    Xoshiro256 aRandom;
+    
+    // Montgomery context of aN and n - 1 = d * 2^s, d odd,
+    // built on the first test that needs it after SetTestNumber
+    Montgomery64 aMont = Montgomery64(1);
+    uint64_t aD = 0;
+    int aS = 0;
+    bool aContextReady = false;
+    
+    // applied to every Montgomery context the tests build
+    PowStrategy aPowStrategy = PowStrategy::Automatic;
+    
+    // aN odd and > 2
+    const Montgomery64& aContext() {
+        if (!aContextReady) {
+            aMont = Montgomery64(aN);
+            aMont.SetStrategy(aPowStrategy);
+            aS = __builtin_ctzll(aN - 1);
+            aD = (aN - 1) >> aS;
+            aContextReady = true;
+        }
+        return aMont;
+    }
+    
+    // Miller-Rabin witness sets
+    // n < 4,759,123,141 : {2, 7, 61} (Jaeschke)
+    // n < 2^64 : 7 bases found by Jim Sinclair
+    static constexpr uint64_t aWitnessLimit32 = 4759123141ULL;
+    static constexpr uint64_t aWitness32[] = {2, 7, 61};
+    static constexpr uint64_t aWitness64[] = {2, 325, 9375, 28178, 450775, 9780504, 1795265022};
+    
+    // independent modexp chains interleaved by the batch test
+    static const int aBatchLanes = 4;
+    
+    // candidates per task of the multithreaded batch test
+    static const size_t aBatchChunk = 1 << 14;
+    
+    // odd offsets sieved at once by the prime generators
+    static const int aPrimeWindow = 4096;
+    
+    // rho steps per GCD of the factorization
+    static const int aRhoBatch = 128;
+    
+    // small prime pre-filter, odd primes below 1024
+    static constexpr SmallPrimeTable aSmallPrimeData = SmallPrimeTable();
+    
+    static constexpr const SmallPrimeTable& aSmallPrimes() {
+        return aSmallPrimeData;
+    }
+    
+    // dispatch thresholds of IsPrime, from --bench
+    // below aTinyLimit a bit lookup, below aTrialLimit trial division by the table
+    // (4x faster than Miller-Rabin on primes), below aWitnessLimit32 the 3-base
+    // Miller-Rabin, above that Baillie-PSW (2x faster than the 7 bases)
+    static constexpr SmallPrimeBitmap aTinyPrimes = SmallPrimeBitmap();
+    static const uint64_t aTinyLimit = SmallPrimeBitmap::limit;
+    static const uint64_t aTrialLimit = 1 << 20;
+    
+    enum FilterVerdict { Composite, Prime, Undecided };
+    
+    int aFilterPrimes = 54;             // odd primes 3 ... 251
+    vector<uint64_t> aFilterProducts;   // primorial blocks behind them
+    
+    // cheap stage in front of every probabilistic test
+    // n < 1024 : table lookup
+    // trial division by the first aFilterPrimes odd primes,
+    // then one GCD per block of the following primes
+    FilterVerdict aPrefilter(uint64_t n) {
+        const SmallPrimeTable& t = aSmallPrimes();
+        
+        if (n%2 == 0 || n < 1024) {
+            bool prime = n == 2 || (n & 1 && binary_search(t.prime, t.prime + t.count, n));
+            PRIMALITY_COUNT(FilterPrime, prime);
+            PRIMALITY_COUNT(FilterTrial, !prime);
+            return prime ? Prime : Composite;
+        }
+        
+        for (int i=0; i<aFilterPrimes; i++) {
+            if (n * t.inverse[i] <= t.limit[i]) {
+                PRIMALITY_COUNT(FilterTrial, 1);
+                return Composite;
+            }
+        }
+        
+        if (aFilterPrimes > 0 && n < t.prime[aFilterPrimes - 1] * t.prime[aFilterPrimes - 1]) {
+            PRIMALITY_COUNT(FilterPrime, 1);
+            return Prime;
+        }
+        
+        // n > 1023 divides no product of primes below 1024 on its own
+        for (uint64_t product : aFilterProducts) {
+            if (aGCD(n, product) != 1) {
+                PRIMALITY_COUNT(FilterGcd, 1);
+                return Composite;
+            }
+        }
+        
+        PRIMALITY_COUNT(FilterPassed, 1);
+        return Undecided;
+    }
+    
+    // composite[i] = 1 if start + 2i has a factor below 1024,
+    // residue[j] = start mod (j-th odd prime)
+    void aSieveWindow(const uint64_t* residue, vector<uint8_t>& composite) {
+        const SmallPrimeTable& t = aSmallPrimes();
+        fill(composite.begin(), composite.end(), 0);
+        
+        for (int j=0; j<t.count; j++) {
+            uint64_t p = t.prime[j],
+                    i = (p - residue[j]) % p * ((p + 1) / 2) % p;
+            for (; i<(uint64_t)aPrimeWindow; i+=p)
+                composite[i] = 1;
+        }
+    }
+    
+    // binary GCD (Stein)
+    // shared factors of 2 come out once, then both stay odd :
+    // the difference of two odd numbers is even, shift its zeros away.
+    // no divide, min / max compile to conditional moves
+    static constexpr uint64_t aGCD (uint64_t n1, uint64_t n2) {
+        if (n1 == 0 || n2 == 0)
+            return n1 | n2;
+        
+        int shift = __builtin_ctzll(n1 | n2);
+        n1 >>= __builtin_ctzll(n1);
+        do {
+            n2 >>= __builtin_ctzll(n2);
+            uint64_t lo = min(n1, n2);
+            n2 = max(n1, n2) - lo;
+            n1 = lo;
+        } while (n2 != 0);
+        
+        return n1 << shift;
+    }
+    
+    // odd modulus : Montgomery form, no division in the loop
+    // even modulus : 128-bit product, never overflows
+    static constexpr uint64_t aPOW (uint64_t base, uint64_t exponent, uint64_t modulus) {
+        if (modulus & 1) {
+            Montgomery64 mont(modulus);
+            return mont.FromMont(mont.Pow(mont.ToMont(base), exponent));
+        }
+        
+        uint64_t result = 1 % modulus;
+        base %= modulus;
+        while (exponent > 0) {
+            if (exponent & 1)
+                result = (uint128)result * base % modulus;
+            
+            base = (uint128)base * base % modulus;
+            
+            exponent >>= 1;
+        }
+        return result;
+    }
+    
+    // bit access shared by the 64-bit and multi-limb kernels
+    static constexpr int aCtz(uint64_t x) {
+        return __builtin_ctzll(x);
+    }
+    
+    static constexpr int aBitLength(uint64_t x) {
+        return x ? 64 - __builtin_clzll(x) : 0;
+    }
+    
+    static constexpr bool aBit(uint64_t x, int i) {
+        return (x >> i) & 1;
+    }
+    
+    template<int L>
+    static int aCtz(const BigUInt<L>& x) {
+        return x.TrailingZeros();
+    }
+    
+    template<int L>
+    static int aBitLength(const BigUInt<L>& x) {
+        return x.BitLength();
+    }
+    
+    template<int L>
+    static bool aBit(const BigUInt<L>& x, int i) {
+        return x.Bit(i);
+    }
+    
+    // strong probable prime test to a single base
+    // n - 1 = d * 2^s, d odd
+    // a^d ≡ 1 or a^(d * 2^r) ≡ -1 (mod n), 0 <= r < s
+    // M is Montgomery64 or MontgomeryBig
+    template<class M>
+    static constexpr bool aStrongProbablePrime(const M& mont, uint64_t a, const typename M::Value& d, int s) {
+        typedef typename M::Value Value;
+        
+        // a base divisible by n proves nothing
+        Value base = mont.ToMont(Value(a));
+        if (base == Value(0))
+            return true;
+        
+        PRIMALITY_COUNT(ModExp, 1);
+        bool doubling = a == 2 && mont.Strategy() != PowStrategy::Binary;
+        Value one = mont.One(),
+                minusOne = mont.Sub(Value(0), one),
+                x = doubling ? mont.PowTwo(d) : mont.Pow(base, d);
+        
+        if (x == one || x == minusOne)
+            return true;
+        
+        for (int r=1; r<s; r++) {
+            x = mont.Mul(x, x);
+            
+            if (x == minusOne)
+                return true;
+            
+            if (x == one)
+                return false;
+        }
+        
+        return false;
+    }
+    
+    // Jacobi symbol (a / n), n odd
+    // (2 / n) = -1 when n ≡ 3, 5 (mod 8)
+    // quadratic reciprocity : (a / n) = -(n / a) when a ≡ n ≡ 3 (mod 4)
+    int aJacobi(uint64_t a, uint64_t n) {
+        int result = 1;
+        a %= n;
+        while (a != 0) {
+            int twos = __builtin_ctzll(a);
+            a >>= twos;
+            
+            if ((twos & 1) && (n % 8 == 3 || n % 8 == 5))
+                result = -result;
+            
+            if (a % 4 == 3 && n % 4 == 3)
+                result = -result;
+            
+            swap(a, n);
+            a %= n;
+        }
+        return n == 1 ? result : 0;
+    }
+    
+    // (D / n) for a small signed D
+    int aJacobiSigned(int64_t D, uint64_t n) {
+        uint64_t absD = D < 0 ? -D : D;
+        return aJacobi(D < 0 ? n - absD % n : absD % n, n);
+    }
+    
+    // multi-limb n : (-1 / n) and (2 / n) from n mod 8,
+    // then reciprocity brings the odd part of |D| down to 64 bits
+    template<int L>
+    int aJacobiSigned(int64_t D, const BigUInt<L>& n) {
+        uint64_t a = D < 0 ? -D : D,
+                n8 = n.limb[0] & 7;
+        int result = 1;
+        
+        if (D < 0 && n8 % 4 == 3)
+            result = -result;
+        
+        int twos = __builtin_ctzll(a);
+        a >>= twos;
+        if ((twos & 1) && (n8 == 3 || n8 == 5))
+            result = -result;
+        
+        if (a == 1)
+            return result;
+        
+        if (a % 4 == 3 && n8 % 4 == 3)
+            result = -result;
+        
+        return result * aJacobi(n.ModSmall(a), a);
+    }
+    
+    bool aIsSquare(uint64_t n) {
+        uint64_t r = IntegerSqrt(n);
+        return r * r == n;
+    }
+    
+    // squares are 0, 1, 4, 9, 16, 17, 25, 33, 36, 41, 49, 57 (mod 64),
+    // the rest gets a bit-by-bit integer square root
+    template<int L>
+    bool aIsSquare(const BigUInt<L>& n) {
+        if (!((0x202021202030213ULL >> (n.limb[0] & 63)) & 1))
+            return false;
+        
+        uint64_t square[2 * L], scratch[LimbMultiply::ScratchLimbs(L)];
+        BigUInt<L> r, low;
+        
+        for (int b=(n.BitLength() + 1) / 2; b>=0; b--) {
+            BigUInt<L> t = r;
+            t.SetBit(b);
+            LimbMultiply::Mul(t.limb, t.limb, L, square, scratch);
+            
+            bool fits = true;
+            for (int i=L; i<2*L; i++)
+                fits = fits && square[i] == 0;
+            copy(square, square + L, low.limb);
+            
+            if (fits && !(n < low)) {
+                r = t;
+                if (low == n)
+                    return true;
+            }
+        }
+        return false;
+    }
+    
+    // strong Lucas probable prime test
+    // Selfridge's method A : first D in 5, -7, 9, -11, ... with (D / n) = -1
+    // P = 1, Q = (1 - D) / 4
+    // n + 1 = d * 2^s, d odd
+    // U_d ≡ 0 or V_(d * 2^r) ≡ 0 (mod n), 0 <= r < s
+    // U_2k = U_k * V_k, V_2k = V_k^2 - 2Q^k
+    // U_k+1 = (P*U_k + V_k) / 2, V_k+1 = (D*U_k + P*V_k) / 2
+    template<class M>
+    bool aStrongLucasProbablePrime(const M& mont) {
+        typedef typename M::Value Value;
+        PRIMALITY_COUNT(Lucas, 1);
+        const Value n = mont.Modulus(),
+                zero = Value(0);
+        
+        int64_t D = 5;
+        for (int tries=0; ; tries++) {
+            // a square n has no D with (D / n) = -1,
+            // only a long search is worth the square root
+            if (tries == 16 && aIsSquare(n))
+                return false;
+            
+            int jacobi = aJacobiSigned(D, n);
+            
+            if (jacobi == -1)
+                break;
+            
+            // n = |D| = 9 reaches here before the square test
+            if (jacobi == 0)
+                return n == Value(D < 0 ? -D : D) && !aIsSquare(n);
+            
+            D = D < 0 ? -D + 2 : -D - 2;
+        }
+        
+        int64_t Q = (1 - D) / 4;
+        Value dm = mont.ToMont(Value(D < 0 ? -D : D)),
+                qm = mont.ToMont(Value(Q < 0 ? -Q : Q));
+        if (D < 0)
+            dm = mont.Sub(zero, dm);
+        if (Q < 0)
+            qm = mont.Sub(zero, qm);
+        
+        // n + 1 = 2 * (n / 2 + 1) for odd n, never overflows
+        Value d = (n >> 1) + Value(1);
+        int s = 1 + aCtz(d);
+        d = d >> (s - 1);
+        
+        Value U = mont.One(),
+                V = mont.One(),
+                Qk = qm;
+        
+        for (int bit=aBitLength(d) - 2; bit>=0; bit--) {
+            U = mont.Mul(U, V);
+            V = mont.Sub(mont.Mul(V, V), mont.Add(Qk, Qk));
+            Qk = mont.Mul(Qk, Qk);
+            
+            if (aBit(d, bit)) {
+                Value u = mont.Half(mont.Add(U, V)),
+                        v = mont.Half(mont.Add(mont.Mul(dm, U), V));
+                U = u;
+                V = v;
+                Qk = mont.Mul(Qk, qm);
+            }
+        }
+        
+        if (U == zero || V == zero)
+            return true;
+        
+        for (int r=1; r<s; r++) {
+            V = mont.Sub(mont.Mul(V, V), mont.Add(Qk, Qk));
+            Qk = mont.Mul(Qk, Qk);
+            
+            if (V == zero)
+                return true;
+        }
+        
+        return false;
+    }
+    
+    // deterministic Miller-Rabin on any 64-bit n
+    bool aMillerRabin64(uint64_t n) {
+        if (n < 2)
+            return false;
+        
+        FilterVerdict v = aPrefilter(n);
+        if (v != Undecided)
+            return v == Prime;
+        
+        return aMillerRabinWitnesses(n);
+    }
+    
+    // base 2 and Lucas rounds alone, n odd and > 2
+    bool aBailliePSW64(uint64_t n) {
+        Montgomery64 mont(n);
+        mont.SetStrategy(aPowStrategy);
+        int s = __builtin_ctzll(n - 1);
+        return aBailliePSW64(mont, (n - 1) >> s, s);
+    }
+    
+    bool aBailliePSW64(const Montgomery64& mont, uint64_t d, int s) {
+        if (!aStrongProbablePrime(mont, 2, d, s))
+            return false;
+        
+        return aStrongLucasProbablePrime(mont);
+    }
+    
+    // the witness rounds alone, n odd and > 2
+    static constexpr bool aMillerRabinWitnesses(uint64_t n) {
+        Montgomery64 mont(n);
+        int s = __builtin_ctzll(n - 1);
+        return aMillerRabinWitnesses(mont, (n - 1) >> s, s);
+    }
+    
+    static constexpr bool aMillerRabinWitnesses(const Montgomery64& mont, uint64_t d, int s) {
+        if (mont.Modulus() < aWitnessLimit32) {
+            for (uint64_t a : aWitness32) {
+                if (!aStrongProbablePrime(mont, a, d, s))
+                    return false;
+            }
+            return true;
+        }
+        
+        for (uint64_t a : aWitness64) {
+            if (!aStrongProbablePrime(mont, a, d, s))
+                return false;
+        }
+        
+        return true;
+    }
+    
+    // base 2 and rounds - 1 random bases, n odd and >= 2^64
+    template<int L>
+    bool aMillerRabinRounds(const BigUInt<L>& n, int rounds) {
+        MontgomeryBig<L> mont(n);
+        mont.SetStrategy(aPowStrategy);
+        BigUInt<L> d = n - BigUInt<L>(1);
+        int s = d.TrailingZeros();
+        d = d >> s;
+        
+        for (int i=0; i<rounds; i++) {
+            uint64_t a = i == 0 ? 2 : 2 + aRandom.Below(UINT64_MAX - 2);
+            if (!aStrongProbablePrime(mont, a, d, s))
+                return false;
+        }
+        
+        return true;
+    }
+    
+    // Pollard's rho with Brent's cycle detection
+    // x -> x^2 + c (mod n) in Montgomery form, powers of two cycle lengths,
+    // the differences x - y are multiplied together and checked with one
+    // GCD every aRhoBatch steps, multiplying by R keeps the GCD unchanged.
+    // a batch overshooting to gcd = n is replayed one step at a time.
+    // returns a nontrivial factor of an odd composite n
+    uint64_t aPollardBrent(uint64_t n) {
+        Montgomery64 mont(n);
+        
+        while (true) {
+            uint64_t c = mont.ToMont(1 + aRandom.Below(n - 1)),
+                    y = mont.ToMont(aRandom.Below(n)),
+                    x = y, ys = y,
+                    q = mont.One(),
+                    g = 1;
+            
+            for (uint64_t r=1; g==1; r*=2) {
+                x = y;
+                for (uint64_t i=0; i<r; i++)
+                    y = mont.Add(mont.Mul(y, y), c);
+                
+                for (uint64_t k=0; k<r && g==1; k+=aRhoBatch) {
+                    ys = y;
+                    for (uint64_t i=0; i<min<uint64_t>(aRhoBatch, r - k); i++) {
+                        y = mont.Add(mont.Mul(y, y), c);
+                        q = mont.Mul(q, mont.Sub(x, y));
+                    }
+                    g = aGCD(q, n);
+                }
+            }
+            
+            if (g == n) {
+                do {
+                    ys = mont.Add(mont.Mul(ys, ys), c);
+                    g = aGCD(mont.Sub(x, ys), n);
+                } while (g == 1);
+            }
+            
+            if (g != n)
+                return g;
+        }
+    }
+    
+    // n has no prime factor below 1024
+    void aFactorRho(uint64_t n, vector<uint64_t>& factors) {
+        if (n == 1)
+            return;
+        
+        if (n < 1024 * 1024 || aMillerRabinWitnesses(n)) {
+            factors.push_back(n);
+            return;
+        }
+        
+        uint64_t d = aPollardBrent(n);
+        aFactorRho(d, factors);
+        aFactorRho(n / d, factors);
+    }
+    
+    // pre-filter for n >= 2^64 : one ModSmall per 64-bit product of
+    // filter primes, the residue is tested against each of them
+    template<int L>
+    FilterVerdict aPrefilter(const BigUInt<L>& n) {
+        const SmallPrimeTable& t = aSmallPrimes();
+        
+        if (!n.IsOdd()) {
+            PRIMALITY_COUNT(FilterTrial, 1);
+            return Composite;
+        }
+        
+        for (int i=0; i<aFilterPrimes; ) {
+            int first = i;
+            uint64_t product = 1;
+            while (i < aFilterPrimes && product <= UINT64_MAX / t.prime[i])
+                product *= t.prime[i++];
+            
+            uint64_t r = n.ModSmall(product);
+            for (int k=first; k<i; k++) {
+                if (r * t.inverse[k] <= t.limit[k]) {
+                    PRIMALITY_COUNT(FilterTrial, 1);
+                    return Composite;
+                }
+            }
+        }
+        
+        for (uint64_t product : aFilterProducts) {
+            if (aGCD(n.ModSmall(product), product) != 1) {
+                PRIMALITY_COUNT(FilterGcd, 1);
+                return Composite;
+            }
+        }
+        
+        PRIMALITY_COUNT(FilterPassed, 1);
+        return Undecided;
+    }
+    
+    // scalar batch kernel
+    // aBatchLanes candidates run one strong test each per round,
+    // their modexp chains are independent so the multiplies overlap.
+    // a lane that finishes its candidate is refilled with the next one.
+    void aBatchScalar(span<const uint64_t> candidates, span<uint8_t> verdicts) {
+        const int L = aBatchLanes;
+        Montgomery64 mont[L] = {1, 1, 1, 1};
+        const uint64_t* witness[L];
+        uint64_t d[L], x[L], base[L], e[L];
+        size_t index[L];
+        int s[L], round[L], rounds[L];
+        bool active[L] = {};
+        size_t next = 0;
+        
+        while (true) {
+            // refill idle lanes, trivial candidates are answered here
+            int busy = 0;
+            for (int l=0; l<L; l++) {
+                while (!active[l] && next < candidates.size()) {
+                    size_t i = next++;
+                    uint64_t n = candidates[i];
+                    
+                    FilterVerdict v = aPrefilter(n);
+                    if (v != Undecided) {
+                        verdicts[i] = v == Prime;
+                        continue;
+                    }
+                    
+                    index[l] = i;
+                    mont[l] = Montgomery64(n);
+                    d[l] = n - 1;
+                    s[l] = __builtin_ctzll(d[l]);
+                    d[l] >>= s[l];
+                    witness[l] = n < aWitnessLimit32 ? aWitness32 : aWitness64;
+                    rounds[l] = n < aWitnessLimit32 ? 3 : 7;
+                    round[l] = 0;
+                    active[l] = true;
+                }
+                busy += active[l];
+            }
+            
+            if (busy == 0)
+                break;
+            
+            // a^d (mod n) for every lane at once
+            int bits = 0;
+            for (int l=0; l<L; l++) {
+                if (!active[l]) {
+                    e[l] = 0;
+                    continue;
+                }
+                // a base divisible by n proves nothing, pass it through
+                uint64_t a = witness[l][round[l]] % mont[l].Modulus();
+                base[l] = mont[l].ToMont(a);
+                x[l] = mont[l].One();
+                e[l] = a == 0 ? 0 : d[l];
+                bits = max(bits, 64 - __builtin_clzll(d[l]));
+            }
+            
+            // branch-free multiply step, exponent bits are unpredictable
+            for (int b=0; b<bits; b++) {
+                for (int l=0; l<L; l++) {
+                    uint64_t xb = mont[l].Mul(x[l], base[l]);
+                    x[l] = (e[l] & 1) ? xb : x[l];
+                    
+                    base[l] = mont[l].Mul(base[l], base[l]);
+                    
+                    e[l] >>= 1;
+                }
+            }
+            
+            // finish each strong test, retire decided lanes
+            for (int l=0; l<L; l++) {
+                if (!active[l])
+                    continue;
+                
+                const Montgomery64& m = mont[l];
+                uint64_t one = m.One(),
+                        minusOne = m.Sub(0, one);
+                bool pass = x[l] == one || x[l] == minusOne;
+                
+                for (int r=1; r<s[l] && !pass; r++) {
+                    x[l] = m.Mul(x[l], x[l]);
+                    
+                    if (x[l] == minusOne)
+                        pass = true;
+                    else if (x[l] == one)
+                        break;
+                }
+                
+                if (!pass || ++round[l] == rounds[l]) {
+                    verdicts[index[l]] = pass;
+                    active[l] = false;
+                }
+            }
+        }
+    }
+
+#if defined(__x86_64__)
+    // SIMD batch kernels
+    // one Miller-Rabin chain per 64-bit lane, R = 2^k Montgomery form
+    // AVX-512 IFMA : 8 lanes, k = 52, n < 2^52
+    // AVX2 : 4 lanes, k = 32, n < 2^32, 32x32 -> 64 multiplies
+    // candidates out of range are left in rest for the scalar kernel
+    template<int L>
+    struct aSimdLanes {
+        alignas(64) uint64_t n[L], inv[L], one[L], r2[L], d[L], s[L], a[L];
+        size_t index[L];
+        int round[L], rounds[L];
+        const uint64_t* witness[L];
+        bool active[L] = {};
+        
+        // returns the number of busy lanes
+        int Refill(PrimalityTest& test, span<const uint64_t> candidates, span<uint8_t> verdicts,
+                size_t& next, int k, vector<size_t>& rest) {
+            int busy = 0;
+            for (int l=0; l<L; l++) {
+                while (!active[l] && next < candidates.size()) {
+                    size_t i = next++;
+                    uint64_t c = candidates[i];
+                    
+                    FilterVerdict v = test.aPrefilter(c);
+                    if (v != Undecided) {
+                        verdicts[i] = v == Prime;
+                        continue;
+                    }
+                    
+                    if (c >> k) {
+                        rest.push_back(i);
+                        continue;
+                    }
+                    
+                    uint64_t x = c;
+                    for (int j=0; j<5; j++)
+                        x *= 2 - c * x;
+                    
+                    index[l] = i;
+                    n[l] = c;
+                    inv[l] = x;
+                    one[l] = ((uint128)1 << k) % c;
+                    r2[l] = ((uint128)1 << (2 * k)) % c;
+                    s[l] = __builtin_ctzll(c - 1);
+                    d[l] = (c - 1) >> s[l];
+                    witness[l] = c < aWitnessLimit32 ? aWitness32 : aWitness64;
+                    rounds[l] = c < aWitnessLimit32 ? 3 : 7;
+                    round[l] = 0;
+                    active[l] = true;
+                }
+                busy += active[l];
+            }
+            return busy;
+        }
+        
+        // base and exponent for this round, 0 exponent for idle lanes
+        // and for bases divisible by n
+        int Prepare(uint64_t* e) {
+            int bits = 0;
+            for (int l=0; l<L; l++) {
+                a[l] = active[l] ? witness[l][round[l]] % n[l] : 0;
+                e[l] = a[l] == 0 ? 0 : d[l];
+                bits = max(bits, 64 - (e[l] ? __builtin_clzll(e[l]) : 64));
+            }
+            return bits;
+        }
+        
+        void Retire(unsigned passMask, span<uint8_t> verdicts) {
+            for (int l=0; l<L; l++) {
+                if (!active[l])
+                    continue;
+                
+                bool pass = (passMask >> l) & 1;
+                if (!pass || ++round[l] == rounds[l]) {
+                    verdicts[index[l]] = pass;
+                    active[l] = false;
+                }
+            }
+        }
+        
+        int MaxS() const {
+            int m = 0;
+            for (int l=0; l<L; l++)
+                m = active[l] ? max(m, (int)s[l]) : m;
+            return m;
+        }
+    };
+    
+    // GCC 12 flags the deliberately undefined register inside the
+    // unmasked AVX-512 intrinsics once they are inlined into callers
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+    
+    // (a*b + m*n) / 2^52, m = -a*b*n^-1 (mod 2^52)
+    // low 52-bit halves sum to 0 or 2^52, the carry is their bit 52
+    __attribute__((target("avx512f,avx512ifma")))
+    static __m512i aMontMul52(__m512i a, __m512i b, __m512i n, __m512i ninv) {
+        const __m512i zero = _mm512_setzero_si512();
+        __m512i lo = _mm512_madd52lo_epu64(zero, a, b),
+                hi = _mm512_madd52hi_epu64(zero, a, b),
+                m = _mm512_madd52lo_epu64(zero, lo, ninv),
+                carry = _mm512_srli_epi64(_mm512_madd52lo_epu64(lo, m, n), 52),
+                r = _mm512_add_epi64(_mm512_madd52hi_epu64(hi, m, n), carry);
+        
+        return _mm512_min_epu64(r, _mm512_sub_epi64(r, n));
+    }
+    
+    __attribute__((target("avx512f,avx512ifma")))
+    void aBatchIFMA(span<const uint64_t> candidates, span<uint8_t> verdicts, vector<size_t>& rest) {
+        aSimdLanes<8> lanes;
+        alignas(64) uint64_t e[8];
+        size_t next = 0;
+        const __m512i mask52 = _mm512_set1_epi64((1ULL << 52) - 1),
+                zero = _mm512_setzero_si512();
+        
+        while (lanes.Refill(*this, candidates, verdicts, next, 52, rest) > 0) {
+            int bits = lanes.Prepare(e);
+            __m512i n = _mm512_load_si512(lanes.n),
+                    ninv = _mm512_and_si512(_mm512_sub_epi64(zero, _mm512_load_si512(lanes.inv)), mask52),
+                    one = _mm512_load_si512(lanes.one),
+                    minusOne = _mm512_sub_epi64(n, one),
+                    base = aMontMul52(_mm512_load_si512(lanes.a), _mm512_load_si512(lanes.r2), n, ninv),
+                    exp = _mm512_load_si512(e),
+                    x = one;
+            
+            for (int b=0; b<bits; b++) {
+                __mmask8 odd = _mm512_test_epi64_mask(exp, _mm512_set1_epi64(1));
+                x = _mm512_mask_blend_epi64(odd, x, aMontMul52(x, base, n, ninv));
+                base = aMontMul52(base, base, n, ninv);
+                exp = _mm512_srli_epi64(exp, 1);
+            }
+            
+            __m512i s = _mm512_load_si512(lanes.s);
+            __mmask8 pass = _mm512_cmpeq_epi64_mask(x, one) | _mm512_cmpeq_epi64_mask(x, minusOne),
+                    dead = 0;
+            
+            for (int r=1, maxS=lanes.MaxS(); r<maxS; r++) {
+                __mmask8 live = _mm512_cmpgt_epi64_mask(s, _mm512_set1_epi64(r)) & ~pass & ~dead;
+                if (live == 0)
+                    break;
+                
+                x = aMontMul52(x, x, n, ninv);
+                pass |= live & _mm512_cmpeq_epi64_mask(x, minusOne);
+                dead |= live & _mm512_cmpeq_epi64_mask(x, one);
+            }
+            
+            lanes.Retire(pass, verdicts);
+        }
+    }
+    
+#pragma GCC diagnostic pop
+    
+    // m = lo(a*b) * n^-1 (mod 2^32), a*b - m*n ≡ 0 (mod 2^32)
+    // (a*b - m*n) / 2^32 = hi(a*b) - hi(m*n), in (-n, n)
+    __attribute__((target("avx2")))
+    static __m256i aMontMul32(__m256i a, __m256i b, __m256i n, __m256i inv) {
+        __m256i t = _mm256_mul_epu32(a, b),
+                m = _mm256_mul_epu32(t, inv),
+                th = _mm256_srli_epi64(t, 32),
+                mh = _mm256_srli_epi64(_mm256_mul_epu32(m, n), 32),
+                borrow = _mm256_cmpgt_epi64(mh, th);
+        
+        return _mm256_add_epi64(_mm256_sub_epi64(th, mh), _mm256_and_si256(borrow, n));
+    }
+    
+    __attribute__((target("avx2")))
+    void aBatchAVX2(span<const uint64_t> candidates, span<uint8_t> verdicts, vector<size_t>& rest) {
+        aSimdLanes<4> lanes;
+        alignas(64) uint64_t e[4];
+        size_t next = 0;
+        const __m256i bit = _mm256_set1_epi64x(1);
+        
+        while (lanes.Refill(*this, candidates, verdicts, next, 32, rest) > 0) {
+            int bits = lanes.Prepare(e);
+            __m256i n = _mm256_load_si256((const __m256i*)lanes.n),
+                    inv = _mm256_load_si256((const __m256i*)lanes.inv),
+                    one = _mm256_load_si256((const __m256i*)lanes.one),
+                    minusOne = _mm256_sub_epi64(n, one),
+                    base = aMontMul32(_mm256_load_si256((const __m256i*)lanes.a),
+                            _mm256_load_si256((const __m256i*)lanes.r2), n, inv),
+                    exp = _mm256_load_si256((const __m256i*)e),
+                    x = one;
+            
+            for (int b=0; b<bits; b++) {
+                __m256i odd = _mm256_cmpeq_epi64(_mm256_and_si256(exp, bit), bit);
+                x = _mm256_blendv_epi8(x, aMontMul32(x, base, n, inv), odd);
+                base = aMontMul32(base, base, n, inv);
+                exp = _mm256_srli_epi64(exp, 1);
+            }
+            
+            __m256i s = _mm256_load_si256((const __m256i*)lanes.s),
+                    pass = _mm256_or_si256(_mm256_cmpeq_epi64(x, one), _mm256_cmpeq_epi64(x, minusOne)),
+                    dead = _mm256_setzero_si256();
+            
+            for (int r=1, maxS=lanes.MaxS(); r<maxS; r++) {
+                __m256i live = _mm256_andnot_si256(_mm256_or_si256(pass, dead),
+                        _mm256_cmpgt_epi64(s, _mm256_set1_epi64x(r)));
+                if (_mm256_testz_si256(live, live))
+                    break;
+                
+                x = aMontMul32(x, x, n, inv);
+                pass = _mm256_or_si256(pass, _mm256_and_si256(live, _mm256_cmpeq_epi64(x, minusOne)));
+                dead = _mm256_or_si256(dead, _mm256_and_si256(live, _mm256_cmpeq_epi64(x, one)));
+            }
+            
+            lanes.Retire(_mm256_movemask_pd(_mm256_castsi256_pd(pass)), verdicts);
+        }
+    }
+#endif
+    
+public:
+    PrimalityTest(uint64_t seed = 0) : aRandom(seed) {}
+    
+    // bases of the probabilistic tests are drawn from this generator,
+    // one per instance so parallel callers never share state
+    void SetSeed(uint64_t seed) {
+        aRandom.Seed(seed);
+    }
+    
+    void SetRandomGenerator(const Xoshiro256& random) {
+        aRandom = random;
+    }
+    
+    Xoshiro256& GetRandomGenerator() {
+        return aRandom;
+    }
+    
+    // pre-filter stage of the probabilistic tests
+    // trial division by the first primes odd primes (at most 171),
+    // then a GCD against each of the next gcdBlocks primorial blocks,
+    // a block being the product of as many following primes as fit 64 bits
+    void SetPrefilter(int primes, int gcdBlocks) {
+        const SmallPrimeTable& t = aSmallPrimes();
+        
+        aFilterPrimes = max(0, min(primes, t.count));
+        aFilterProducts.clear();
+        
+        for (int i=aFilterPrimes; i<t.count && (int)aFilterProducts.size()<gcdBlocks; ) {
+            uint64_t product = 1;
+            while (i < t.count && product <= UINT64_MAX / t.prime[i])
+                product *= t.prime[i++];
+            aFilterProducts.push_back(product);
+        }
+    }
+    
+    // exponentiation of the following tests, Automatic by default
+    // the static paths (constexpr test, prime generation) stay Automatic
+    void SetExponentiation(PowStrategy strategy) {
+        aPowStrategy = strategy;
+        aContextReady = false;
+    }
+    
+    PowStrategy GetExponentiation() {
+        return aPowStrategy;
+    }
+    
+    void SetTestNumber(uint64_t N) {
+        aN = N;
+        aContextReady = false;
+    }
+    
+    uint64_t GetTestNumber() {
+        return aN;
+    }
+    
+    // Trial Division Method
+    bool SimplePrimalityTest() {
+        PRIMALITY_TIME(Simple);
+        if (aN < 2)
+            return false;
+        
+        if (aN==2 || aN==3)
+            return true;
+        
+        for (uint64_t i=2; i<=aN/i; i++) {
+            PRIMALITY_COUNT(Division, 1);
+            if (aN%i == 0)
+                return false;
+        }
+        
+        return true;
+    }
+    
+    // trial division by the primes of the table, then 6k +- 1 past its end
+    bool SimplePrimalityTest(const PrimeTable& primes) {
+        PRIMALITY_TIME(Simple);
+        if (primes.Last() < 5)
+            return SimplePrimalityTestOptimize();
+        
+        if (aN < 2)
+            return false;
+        
+        for (uint64_t p : primes) {
+            if (p > aN / p)
+                return true;
+            
+            PRIMALITY_COUNT(Division, 1);
+            if (aN%p == 0)
+                return aN == p;
+        }
+        
+        for (uint64_t i=primes.Last()-primes.Last()%6+5; i<=aN/i; i+=6) {
+            PRIMALITY_COUNT(Division, 2);
+            if (aN%i == 0 || aN%(i+2) == 0)
+                return false;
+        }
+        
+        return true;
+    }
+    
+    // Optimize Trial Division Method
+    // p = 6k +- 1, (p > 3)
+    // n = 6k + i, 
+    // (6k + 0) & (6k + 2) & (6k + 4) ≡ 0 (mod 2)
+    // (6k + 3) ≡ 0 (mod 3)
+    // remain (6k - 1) & (6k + 1)
+    bool SimplePrimalityTestOptimize() {
+        PRIMALITY_TIME(SimpleOptimize);
+        if (aN==2 || aN==3)
+            return true;
+    
+        if (aN<2 || aN%2 == 0 || aN%3 == 0)
+            return false;
+    
+        for (uint64_t i=5; i<=aN/i; i+=6) {
+            PRIMALITY_COUNT(Division, 2);
+            if (aN%i == 0 || aN%(i+2) == 0)
+                return false;
+        }
+        
+        return true;
+    }
+    
+    // Wilson's Theorem
+    // if p is prime, (p - 1)! ≡ -1 (mod p)
+    // work on (n <= 20), 21! > 2^64
+    bool WilsonsPrimalityTest() {
+        PRIMALITY_TIME(Wilson);
+        if (aN<2 || aN>20)
+            return false;
+        
+        uint64_t p=1;
+        for (uint64_t i=1; i<aN; i++) 
+            p *= i;
+        
+        if (p%aN == aN-1)
+            return true;
+            
+        return false;
+    }
+    
+    // probable prime
+    // Fermat’s little theorem
+    // a^(p-1) ≡ 1 (mod p), a != 0
+    bool FermatsPrimalityTest() {
+        static const uint64_t base2[] = {2};
+        return FermatsPrimalityTest(base2);
+    }
+    
+    // Fermat test to every base, bases divisible by n are skipped
+    bool FermatsPrimalityTest(span<const uint64_t> bases) {
+        PRIMALITY_TIME(Fermat);
+        if (aN < 2)
+            return false;
+        
+        FilterVerdict v = aPrefilter(aN);
+        if (v != Undecided)
+            return v == Prime;
+        
+        const Montgomery64& mont = aContext();
+        for (uint64_t a : bases) {
+            a %= aN;
+            PRIMALITY_COUNT(ModExp, a != 0);
+            if (a != 0 && mont.Pow(mont.ToMont(a), aN - 1) != mont.One())
+                return false;
+        }
+        
+        return true;
+    }
+    
+    // strong probable prime (SPRP)
+    // n - 1 = d * 2^s, a^d ≡ 1 or a^(d * 2^r) ≡ -1 (mod n), 0 <= r < s
+    // never weaker than the Fermat test to the same base
+    bool StrongFermatsPrimalityTest() {
+        static const uint64_t base2[] = {2};
+        return StrongFermatsPrimalityTest(base2);
+    }
+    
+    bool StrongFermatsPrimalityTest(span<const uint64_t> bases) {
+        PRIMALITY_TIME(StrongFermat);
+        if (aN < 2)
+            return false;
+        
+        FilterVerdict v = aPrefilter(aN);
+        if (v != Undecided)
+            return v == Prime;
+        
+        const Montgomery64& mont = aContext();
+        for (uint64_t a : bases) {
+            if (!aStrongProbablePrime(mont, a, aD, aS))
+                return false;
+        }
+        
+        return true;
+    }
+    
+    // probable prime
+    // Solovay-Strassen primality test
+    // Euler's criterion : a^((n-1)/2) ≡ (a / n) (mod n)
+    bool SolovayStrassenPrimalityTest(int iterations) {
+        PRIMALITY_TIME(SolovayStrassen);
+        if (aN < 2)
+            return false;
+        
+        FilterVerdict v = aPrefilter(aN);
+        if (v != Undecided)
+            return v == Prime;
+        
+        // Montgomery form throughout, 1 and -1 compare as R and n - R
+        const Montgomery64& mont = aContext();
+        uint64_t one = mont.One(),
+                minusOne = mont.Sub(0, one);
+        
+        for (int i=0; i<iterations; i++) {
+            PRIMALITY_COUNT(ModExp, 1);
+            uint64_t a = 2 + aRandom.Below(aN - 3),
+                    euler = mont.Pow(mont.ToMont(a), (aN-1) / 2);
+            int jacobi = aJacobi(a, aN);
+            
+            if (jacobi == 0)
+                return false;
+                
+            if (euler != (jacobi == 1 ? one : minusOne))
+                return false;
+        }
+        
+        return true;
+    }
+    
+    // modular inverse, a * x ≡ 1 (mod m), 0 if gcd(a, m) != 1
+    // extended Euclid on magnitudes : the Bezout coefficients of a
+    // alternate in sign, so the parity of the step count gives the sign
+    static constexpr uint64_t ModularInverse(uint64_t a, uint64_t m) {
+        uint64_t r0 = m, r1 = a % m,
+                t0 = 0, t1 = 1;
+        int steps = 0;
+        
+        while (r1 != 0) {
+            uint64_t q = r0 / r1,
+                    r = r0 - q * r1,
+                    t = t0 + q * t1;
+            r0 = r1, r1 = r;
+            t0 = t1, t1 = t;
+            steps++;
+        }
+        
+        if (r0 != 1)
+            return 0;
+        
+        return steps & 1 ? t0 : (m - t0) % m;
+    }
+    
+    // compile-time primality
+    // the small prime table, then the deterministic witness sets,
+    // usable in static_assert and constant initializers
+    static constexpr bool ConstexprPrimalityTest(uint64_t n) {
+        if (n < 2)
+            return false;
+        
+        if (n%2 == 0)
+            return n == 2;
+        
+        const SmallPrimeTable& t = aSmallPrimes();
+        for (int i=0; i<t.count; i++) {
+            if (n == t.prime[i])
+                return true;
+            
+            if (n * t.inverse[i] <= t.limit[i])
+                return false;
+        }
+        
+        return n < 1024 * 1024 || aMillerRabinWitnesses(n);
+    }
+    
+    // Primality of any n
+    // the fastest deterministic test for the size of n, lookup, trial division,
+    // Miller-Rabin or Baillie-PSW, one range compare per step
+    bool IsPrime(uint64_t n) {
+        PRIMALITY_TIME(Dispatch);
+        if (n < aTinyLimit)
+            return n == 2 || (n & 1 && aTinyPrimes.Test(n));
+        
+        if (n%2 == 0)
+            return false;
+        
+        if (n < aTrialLimit) {
+            const SmallPrimeTable& t = aSmallPrimes();
+            for (int i=0; i<t.count && t.prime[i]*t.prime[i]<=n; i++) {
+                PRIMALITY_COUNT(Division, 1);
+                if (n * t.inverse[i] <= t.limit[i])
+                    return false;
+            }
+            return true;
+        }
+        
+        if (n < aWitnessLimit32)
+            return aMillerRabin64(n);
+        
+        FilterVerdict v = aPrefilter(n);
+        if (v != Undecided)
+            return v == Prime;
+        
+        return aBailliePSW64(n);
+    }
+    
+    // multi-limb n : Baillie-PSW
+    template<int L>
+    bool IsPrime(const BigUInt<L>& n) {
+        if (n.FitsUInt64())
+            return IsPrime(n.limb[0]);
+        
+        return BailliePSWPrimalityTest(n);
+    }
+    
+    // Miller-Rabin primality test
+    // deterministic for every 64-bit n with fixed witness sets
+    bool MillerRabinPrimalityTest() {
+        PRIMALITY_TIME(MillerRabin);
+        if (aN < 2)
+            return false;
+        
+        FilterVerdict v = aPrefilter(aN);
+        if (v != Undecided)
+            return v == Prime;
+        
+        const Montgomery64& mont = aContext();
+        return aMillerRabinWitnesses(mont, aD, aS);
+    }
+    
+    // Baillie-PSW primality test
+    // strong probable prime to base 2 and strong Lucas probable prime
+    // no known counterexample, none below 2^64
+    bool BailliePSWPrimalityTest() {
+        PRIMALITY_TIME(BailliePSW);
+        if (aN < 2)
+            return false;
+        
+        FilterVerdict v = aPrefilter(aN);
+        if (v != Undecided)
+            return v == Prime;
+        
+        const Montgomery64& mont = aContext();
+        return aBailliePSW64(mont, aD, aS);
+    }
+    
+    // Miller-Rabin primality test for multi-limb n
+    // n < 2^64 : the deterministic 64-bit test
+    // otherwise base 2 and rounds - 1 random bases, error < 4^-rounds
+    template<int L>
+    bool MillerRabinPrimalityTest(const BigUInt<L>& n, int rounds) {
+        PRIMALITY_TIME(MillerRabin);
+        if (n.FitsUInt64())
+            return aMillerRabin64(n.limb[0]);
+        
+        FilterVerdict v = aPrefilter(n);
+        if (v != Undecided)
+            return v == Prime;
+        
+        return aMillerRabinRounds(n, rounds);
+    }
+    
+    // Baillie-PSW primality test for multi-limb n
+    template<int L>
+    bool BailliePSWPrimalityTest(const BigUInt<L>& n) {
+        PRIMALITY_TIME(BailliePSW);
+        if (n.FitsUInt64())
+            return aMillerRabin64(n.limb[0]);
+        
+        FilterVerdict v = aPrefilter(n);
+        if (v != Undecided)
+            return v == Prime;
+        
+        MontgomeryBig<L> mont(n);
+        mont.SetStrategy(aPowStrategy);
+        BigUInt<L> d = n - BigUInt<L>(1);
+        int s = d.TrailingZeros();
+        d = d >> s;
+        
+        if (!aStrongProbablePrime(mont, 2, d, s))
+            return false;
+        
+        return aStrongLucasProbablePrime(mont);
+    }
+    
+    // Integer factorization
+    // prime factors of n in increasing order, with multiplicity
+    // trial division by the primes below 1024, exact division n / p = n * p^-1,
+    // then Pollard-Brent rho on the cofactor, split until Miller-Rabin says prime
+    vector<uint64_t> Factorize() {
+        PRIMALITY_TIME(Factorize);
+        const SmallPrimeTable& t = aSmallPrimes();
+        vector<uint64_t> factors;
+        uint64_t n = aN;
+        
+        if (n < 2)
+            return factors;
+        
+        for (; n%2 == 0; n/=2)
+            factors.push_back(2);
+        
+        for (int j=0; j<t.count && t.prime[j]*t.prime[j]<=n; j++) {
+            PRIMALITY_COUNT(Division, 1);
+            while (n * t.inverse[j] <= t.limit[j]) {
+                factors.push_back(t.prime[j]);
+                n *= t.inverse[j];
+            }
+        }
+        
+        if (n > 1 && n < 1024 * 1024)
+            factors.push_back(n);
+        else
+            aFactorRho(n, factors);
+        
+        sort(factors.begin(), factors.end());
+        return factors;
+    }
+    
+    // same factors, one table walk for n below table.Limit(), else the above
+    vector<uint64_t> Factorize(const FactorTable& table) {
+        if (aN < 2 || aN >= table.Limit())
+            return Factorize();
+        
+        PRIMALITY_TIME(Factorize);
+        return table.FactorizeSmall(aN);
+    }
+    
+    // Random prime generation, incremental sieve
+    // start at a random odd number of the requested size and sieve the
+    // window start, start + 2, ..., start + 2(aPrimeWindow - 1)
+    // against the odd primes below 1024 : start + 2i ≡ 0 (mod p) for
+    // i ≡ -start / 2 (mod p). only survivors reach Miller-Rabin,
+    // an exhausted window slides forward and is sieved again.
+    
+    // random prime of exactly bits bits, 2 <= bits <= 64
+    uint64_t RandomPrime(int bits) {
+        uint64_t top = 1ULL << (bits - 1),
+                mask = bits == 64 ? UINT64_MAX : 2 * top - 1;
+        
+        // few enough candidates to test them all
+        if (bits <= 20) {
+            while (true) {
+                uint64_t n = (aRandom.Next() & mask) | top | (bits > 1);
+                if (aMillerRabin64(n))
+                    return n;
+            }
+        }
+        
+        const SmallPrimeTable& t = aSmallPrimes();
+        vector<uint8_t> composite(aPrimeWindow);
+        uint64_t residue[172];
+        
+        while (true) {
+            uint64_t base = aRandom.Odd(bits);
+            for (int j=0; j<t.count; j++)
+                residue[j] = base % t.prime[j];
+            
+            // slide the window until it leaves the bit size
+            bool inRange = true;
+            while (inRange) {
+                aSieveWindow(residue, composite);
+                
+                for (int i=0; i<aPrimeWindow && inRange; i++) {
+                    uint64_t n = base + 2 * i;
+                    inRange = n >= base && n <= mask;
+                    
+                    if (inRange && !composite[i] && aMillerRabinWitnesses(n))
+                        return n;
+                }
+                
+                uint64_t next = base + 2 * aPrimeWindow;
+                inRange = inRange && next > base && next <= mask;
+                base = next;
+                
+                for (int j=0; j<t.count; j++)
+                    residue[j] = (residue[j] + 2 * aPrimeWindow) % t.prime[j];
+            }
+        }
+    }
+    
+    // random odd number of exactly bits bits, 2 <= bits <= 64 L
+    // only the (bits + 63) / 64 filled limbs are shifted down to size
+    template<int L>
+    BigUInt<L> RandomOdd(int bits) {
+        int limbs = (bits + 63) / 64;
+        BigUInt<L> n;
+        for (int i=0; i<limbs; i++)
+            n.limb[i] = aRandom.Next();
+        n = n >> (64 * limbs - bits);
+        n.SetBit(bits - 1);
+        n.SetBit(0);
+        return n;
+    }
+    
+    // random probable prime of exactly bits bits, bits <= 64 L
+    // each survivor of the sieve gets rounds Miller-Rabin rounds
+    template<int L>
+    BigUInt<L> RandomProbablePrime(int bits, int rounds = 20) {
+        if (bits <= 64)
+            return BigUInt<L>(RandomPrime(bits));
+        
+        const SmallPrimeTable& t = aSmallPrimes();
+        vector<uint8_t> composite(aPrimeWindow);
+        uint64_t residue[172];
+        
+        while (true) {
+            BigUInt<L> start = RandomOdd<L>(bits);
+            for (int j=0; j<t.count; j++)
+                residue[j] = start.ModSmall(t.prime[j]);
+            
+            BigUInt<L> base = start;
+            while (true) {
+                aSieveWindow(residue, composite);
+                
+                for (int i=0; i<aPrimeWindow; i++) {
+                    if (composite[i])
+                        continue;
+                    
+                    BigUInt<L> n = base + BigUInt<L>(2 * i);
+                    if (n.BitLength() != bits)
+                        break;
+                    
+                    if (aMillerRabinRounds(n, rounds))
+                        return n;
+                }
+                
+                base = base + BigUInt<L>(2 * aPrimeWindow);
+                if (base.BitLength() != bits)
+                    break;
+                
+                for (int j=0; j<t.count; j++)
+                    residue[j] = (residue[j] + 2 * aPrimeWindow) % t.prime[j];
+            }
+        }
+    }
+    
+    // Batch Miller-Rabin primality test
+    // verdicts[i] = 1 if candidates[i] is prime, else 0
+    // runtime dispatch : AVX-512 IFMA, AVX2, scalar,
+    // candidates too wide for the SIMD lanes go to the scalar kernel
+    void BatchPrimalityTest(span<const uint64_t> candidates, span<uint8_t> verdicts) {
+        PRIMALITY_TIME(Batch);
+        vector<size_t> rest;
+        
+#if defined(__x86_64__)
+        static const bool hasIFMA = __builtin_cpu_supports("avx512ifma"),
+                hasAVX2 = __builtin_cpu_supports("avx2");
+        
+        if (hasIFMA)
+            aBatchIFMA(candidates, verdicts, rest);
+        else if (hasAVX2)
+            aBatchAVX2(candidates, verdicts, rest);
+        else
+            return aBatchScalar(candidates, verdicts);
+#else
+        return aBatchScalar(candidates, verdicts);
+#endif
+        
+        if (rest.empty())
+            return;
+        
+        vector<uint64_t> wide(rest.size());
+        vector<uint8_t> wideVerdicts(rest.size());
+        for (size_t i=0; i<rest.size(); i++)
+            wide[i] = candidates[rest[i]];
+        
+        aBatchScalar(wide, wideVerdicts);
+        
+        for (size_t i=0; i<rest.size(); i++)
+            verdicts[rest[i]] = wideVerdicts[i];
+    }
+    
+    // multithreaded batch test
+    // chunks of aBatchChunk candidates write disjoint verdict slices,
+    // so the result does not depend on the thread count
+    void BatchPrimalityTest(span<const uint64_t> candidates, span<uint8_t> verdicts, WorkStealingPool& pool) {
+        size_t chunks = (candidates.size() + aBatchChunk - 1) / aBatchChunk;
+        pool.ParallelFor(chunks, [&](size_t c) {
+            size_t first = c * aBatchChunk,
+                    count = min(aBatchChunk, candidates.size() - first);
+            BatchPrimalityTest(candidates.subspan(first, count), verdicts.subspan(first, count));
+        });
+    }
+
+};
+
+static_assert(PrimalityTest::ConstexprPrimalityTest(2147483647));
+static_assert(PrimalityTest::ConstexprPrimalityTest(18446744073709551557ULL));
+static_assert(!PrimalityTest::ConstexprPrimalityTest(3825123056546413051ULL));
+static_assert(PrimalityTest::ModularInverse(3, 7) == 5);
+static_assert(PrimalityTest::ModularInverse(6, 9) == 0);
+
+// Segmented Sieve of Eratosthenes
+// wheel-30, the 6k +- 1 idea of SimplePrimalityTestOptimize with 5 added :
+// only n ≡ 1, 7, 11, 13, 17, 19, 23, 29 (mod 30) can be prime (n > 5),
+// so one byte holds the 8 candidates of a block of 30 numbers.
+// [lo, hi) is sieved one cache-sized segment at a time,
+// every sieving prime remembers its next multiple between segments.
+class SegmentedSieve {
+private:
+    size_t aSegmentBytes;
+    vector<uint32_t> aPrimes;   // sieving primes 7 <= p <= sqrt(limit)
+    uint64_t aLimit = 0;        // aPrimes covers every hi <= aLimit
+    
+    static constexpr uint8_t aResidue[8] = {1, 7, 11, 13, 17, 19, 23, 29};
+    static constexpr uint8_t aGap[8] = {6, 4, 2, 4, 2, 4, 6, 2};
+    static constexpr int8_t aBit[30] = {
+        -1, 0, -1, -1, -1, -1, -1, 1, -1, -1, -1, 2, -1, 3, -1,
+        -1, -1, 4, -1, 5, -1, -1, -1, 6, -1, -1, -1, -1, -1, 7
+    };
+    
+    // about 8 chunks per thread for stealing to balance,
+    // at least 16 segments each to amortize the multiple table setup
+    // sieving primes are built once here, the tasks only read them
+    vector<pair<uint64_t, uint64_t>> aChunks(uint64_t lo, uint64_t hi, size_t threads) {
+        vector<pair<uint64_t, uint64_t>> chunks;
+        if (lo >= hi)
+            return chunks;
+        
+        aSievingPrimes(hi - 1);
+        
+        uint64_t stride = 30 * aSegmentBytes,
+                size = max(16 * stride, (hi - lo) / (8 * threads));
+        size = (size + stride - 1) / stride * stride;
+        
+        for (uint64_t first=lo; first<hi; ) {
+            uint64_t last = hi - first > size ? first - first % 30 + size : hi;
+            chunks.push_back({first, last});
+            first = last;
+        }
+        return chunks;
+    }
+    
+    // the primes up to sqrt(hi), a plain sieve up to 2^20, above it a
+    // segmented pass over [7, sqrt(hi)] with the primes up to hi^(1/4)
+    void aSievingPrimes(uint64_t hi) {
+        if (hi <= aLimit)
+            return;
+        
+        uint64_t root = IntegerSqrt(hi);
+        aPrimes.clear();
+        aLimit = root >= UINT32_MAX ? UINT64_MAX : (root + 1) * (root + 1) - 1;
+        
+        if (root >= (1 << 20)) {
+            aPrimes.reserve(1.1 * root / log(root));
+            SegmentedSieve().ForEachPrime(7, root + 1, [&](uint64_t p) {
+                aPrimes.push_back(p);
+            });
+            return;
+        }
+        
+        vector<bool> composite(root + 1);
+        for (uint64_t i=2; i<=root; i++) {
+            if (composite[i])
+                continue;
+            
+            if (i >= 7)
+                aPrimes.push_back(i);
+            
+            for (uint64_t j=i*i; j<=root; j+=i)
+                composite[j] = true;
+        }
+    }
+    
+    // clear bits of byte b (block low + 30b) holding values outside [lo, hi),
+    // v < block is a value past 2^64
+    static uint8_t aClip(uint64_t block, uint8_t bits, uint64_t lo, uint64_t hi) {
+        for (int i=0; i<8; i++) {
+            uint64_t v = block + aResidue[i];
+            if (v < block || v < lo || v >= hi || v == 1)
+                bits &= ~(1 << i);
+        }
+        return bits;
+    }
+    
+public:
+    SegmentedSieve(size_t segmentBytes = 32 * 1024) {
+        SetSegmentBytes(segmentBytes);
+    }
+    
+    // 32 KiB fits L1, 256 KiB - 1 MiB fits L2
+    void SetSegmentBytes(size_t segmentBytes) {
+        aSegmentBytes = max<size_t>(1, segmentBytes);
+    }
+    
+    size_t GetSegmentBytes() {
+        return aSegmentBytes;
+    }
+    
+    // wheel position of n : bit of byte n / 30, -1 if gcd(n, 30) > 1
+    static constexpr int WheelBit(uint64_t n) {
+        return aBit[n % 30];
+    }
+    
+    static constexpr uint64_t WheelValue(uint64_t byte, int bit) {
+        return 30 * byte + aResidue[bit];
+    }
+    
+    // calls f(low, segment, bytes) for each sieved segment of [lo, hi)
+    // bit i of segment[b] set <=> low + 30b + aResidue[i] is a prime in [lo, hi)
+    // 2, 3 and 5 are not in the wheel, callers add them.
+    // any hi <= 2^64 - 1 : multiples that would pass 2^64 park at UINT64_MAX,
+    // the last segment ends at hi, not at the wrapped low + 30 bytes
+    template<class F>
+    void ForEachSegment(uint64_t lo, uint64_t hi, F f) {
+        if (lo >= hi)
+            return;
+        
+        aSievingPrimes(hi - 1);
+        
+        uint64_t low = lo - lo % 30;
+        vector<uint8_t> segment(aSegmentBytes);
+        
+        // first multiple m = p * k >= max(p^2, low) with gcd(k, 30) = 1
+        vector<uint64_t> multiple(aPrimes.size());
+        vector<uint8_t> wheel(aPrimes.size());
+        for (size_t j=0; j<aPrimes.size(); j++) {
+            uint64_t p = aPrimes[j],
+                    k = max(p, low / p + (low % p != 0));
+            while (aBit[k % 30] < 0)
+                k++;
+            multiple[j] = k > UINT64_MAX / p ? UINT64_MAX : p * k;
+            wheel[j] = aBit[k % 30];
+        }
+        
+        const uint64_t stride = 30 * aSegmentBytes;
+        for (;; low += stride) {
+            bool last = hi - low <= stride;
+            size_t bytes = last ? (hi - low + 29) / 30 : aSegmentBytes;
+            uint64_t high = last ? hi : low + stride;
+            fill(segment.begin(), segment.begin() + bytes, 0xff);
+            
+            for (size_t j=0; j<aPrimes.size(); j++) {
+                uint64_t p = aPrimes[j],
+                        m = multiple[j];
+                int w = wheel[j];
+                
+                if (m >= high) {
+                    if (p * p >= high)
+                        break;
+                    continue;
+                }
+                
+                while (m < high) {
+                    uint64_t offset = m - low,
+                            step = p * aGap[w];
+                    segment[offset / 30] &= ~(1 << aBit[offset % 30]);
+                    m = m > UINT64_MAX - step ? UINT64_MAX : m + step;
+                    w = (w + 1) & 7;
+                }
+                multiple[j] = m;
+                wheel[j] = w;
+            }
+            
+            segment[0] = aClip(low, segment[0], lo, hi);
+            segment[bytes - 1] = aClip(low + 30 * (bytes - 1), segment[bytes - 1], lo, hi);
+            
+            f(low, (const uint8_t*)segment.data(), bytes);
+            if (last)
+                break;
+        }
+    }
+    
+    // calls f(p) for every prime lo <= p < hi in increasing order
+    template<class F>
+    void ForEachPrime(uint64_t lo, uint64_t hi, F f) {
+        for (uint64_t p : {2, 3, 5}) {
+            if (lo <= p && p < hi)
+                f(p);
+        }
+        
+        ForEachSegment(lo, hi, [&](uint64_t low, const uint8_t* segment, size_t bytes) {
+            for (size_t b=0; b<bytes; b++) {
+                for (unsigned bits=segment[b]; bits; bits&=bits-1)
+                    f(low + 30 * b + aResidue[__builtin_ctz(bits)]);
+            }
+        });
+    }
+    
+    // the first count primes, p_n < n (ln n + ln ln n) for n >= 6.
+    // cut at 304599508537 if count goes past it, check Size()
+    PrimeTable Table(uint64_t count) {
+        PrimeTable table;
+        table.Reserve(count);
+        
+        long double ln = logl(max<uint64_t>(count, 6));
+        uint64_t bound = max<uint64_t>(count, 6) * (ln + logl(ln)) + 1;
+        bool full = false;
+        for (uint64_t lo=0; table.Size()<count && !full; lo+=bound) {
+            ForEachPrime(lo, lo + bound, [&](uint64_t p) {
+                if (!full && table.Size() < count)
+                    full = !table.Push(p);
+            });
+        }
+        return table;
+    }
+    
+    vector<uint64_t> Primes(uint64_t lo, uint64_t hi) {
+        vector<uint64_t> primes;
+        ForEachPrime(lo, hi, [&](uint64_t p) {
+            primes.push_back(p);
+        });
+        return primes;
+    }
+    
+    // number of primes lo <= p < hi
+    uint64_t CountPrimes(uint64_t lo, uint64_t hi) {
+        uint64_t count = 0;
+        for (uint64_t p : {2, 3, 5}) {
+            if (lo <= p && p < hi)
+                count++;
+        }
+        
+        ForEachSegment(lo, hi, [&](uint64_t, const uint8_t* segment, size_t bytes) {
+            size_t b = 0;
+            for (; b+8<=bytes; b+=8) {
+                uint64_t word;
+                memcpy(&word, segment + b, 8);
+                count += __builtin_popcountll(word);
+            }
+            for (; b<bytes; b++)
+                count += __builtin_popcount(segment[b]);
+        });
+        return count;
+    }
+    
+    // multithreaded versions
+    // [lo, hi) is cut into chunks of whole segments, each task sieves one
+    // chunk with its own segment buffer and multiple table,
+    // partial results are merged in chunk order
+    uint64_t CountPrimes(uint64_t lo, uint64_t hi, WorkStealingPool& pool) {
+        vector<pair<uint64_t, uint64_t>> chunks = aChunks(lo, hi, pool.Size());
+        vector<uint64_t> counts(chunks.size());
+        pool.ParallelFor(chunks.size(), [&](size_t c) {
+            counts[c] = CountPrimes(chunks[c].first, chunks[c].second);
+        });
+        
+        uint64_t count = 0;
+        for (uint64_t c : counts)
+            count += c;
+        return count;
+    }
+    
+    vector<uint64_t> Primes(uint64_t lo, uint64_t hi, WorkStealingPool& pool) {
+        vector<pair<uint64_t, uint64_t>> chunks = aChunks(lo, hi, pool.Size());
+        vector<vector<uint64_t>> parts(chunks.size());
+        pool.ParallelFor(chunks.size(), [&](size_t c) {
+            parts[c] = Primes(chunks[c].first, chunks[c].second);
+        });
+        
+        vector<uint64_t> primes;
+        for (vector<uint64_t>& part : parts)
+            primes.insert(primes.end(), part.begin(), part.end());
+        return primes;
+    }
+};
+
+// Prime counting function pi(x), Lucy_Hedgehog's method
+// S(v, p) = #{2 <= n <= v : n is prime or has no prime factor <= p}
+// only the O(sqrt x) values v = x / k are ever needed,
+// S(v, p) = S(v, p-1) - (S(v / p, p-1) - S(p - 1, p-1)) for v >= p^2,
+// sieving with every prime p <= sqrt(x) leaves S(v) = pi(v).
+// O(x^(3/4)) time, O(sqrt x) memory, the sieving primes come from SegmentedSieve.
+// NthPrime : an estimate, pi at the estimate, then a local sieve walk.
+class PrimeCounting {
+private:
+    // floor(x / d) for x < 2^52
+    static uint64_t aQuotient(uint64_t x, uint64_t d) {
+        uint64_t q = (double)x / (double)d;
+        q -= q * d > x;
+        q += (q + 1) * d <= x;
+        return q;
+    }
+    
+    // primes per sieve step of NthPrime
+    static const uint64_t aWindow = 1 << 22;
+    
+public:
+    static uint64_t Pi(uint64_t x) {
+        if (x < 2)
+            return 0;
+        
+        uint64_t r = IntegerSqrt(x);
+        
+        // small[v] = S(v), v <= r ; large[k] = S(x / k), k <= r
+        bool exact = x < (1ull << 52);
+        vector<uint32_t> small(r + 1);
+        vector<uint64_t> large(r + 1);
+        for (uint64_t v=1; v<=r; v++) {
+            small[v] = v - 1;
+            large[v] = x / v - 1;
+        }
+        
+        SegmentedSieve sieve;
+        sieve.ForEachPrime(2, r + 1, [&](uint64_t p) {
+            uint64_t sp = small[p - 1],
+                    p2 = p * p,
+                    kMax = min(r, x / p2);
+            
+            // quotients through double are off by at most one below 2^52,
+            // fixed up and still far cheaper than a 64-bit divide
+            double inverse = 1.0 / p;
+            for (uint64_t k=1; k<=kMax; k++) {
+                uint64_t kp = k * p,
+                        q = exact ? aQuotient(x, kp) : x / kp;
+                large[k] -= (kp <= r ? large[kp] : small[q]) - sp;
+            }
+            
+            for (uint64_t v=r; v>=p2; v--) {
+                uint64_t q = (uint64_t)(v * inverse);
+                q -= q * p > v;
+                q += (q + 1) * p <= v;
+                small[v] -= small[q] - sp;
+            }
+        });
+        
+        return large[1];
+    }
+    
+    // n-th prime, NthPrime(1) = 2
+    // p_n ≈ n (ln n + ln ln n - 1 + (ln ln n - 2) / ln n), n >= 6
+    static uint64_t NthPrime(uint64_t n) {
+        if (n == 0)
+            return 0;
+        
+        SegmentedSieve sieve;
+        if (n < 6) {
+            vector<uint64_t> primes = sieve.Primes(0, 12);
+            return primes[n - 1];
+        }
+        
+        long double ln = logl(n),
+                lnln = logl(ln),
+                guess = n * (ln + lnln - 1 + (lnln - 2) / ln);
+        uint64_t estimate = guess,
+                count = Pi(estimate);
+        
+        // walk down from the estimate : the (count - n + 1)-th prime <= estimate
+        if (count >= n) {
+            uint64_t need = count - n + 1,
+                    hi = estimate + 1;
+            while (true) {
+                uint64_t lo = hi > aWindow ? hi - aWindow : 0;
+                vector<uint64_t> primes = sieve.Primes(lo, hi);
+                if (primes.size() >= need)
+                    return primes[primes.size() - need];
+                need -= primes.size();
+                hi = lo;
+            }
+        }
+        
+        // walk up : the (n - count)-th prime > estimate
+        uint64_t need = n - count,
+                lo = estimate + 1;
+        while (true) {
+            vector<uint64_t> primes = sieve.Primes(lo, lo + aWindow);
+            if (primes.size() >= need)
+                return primes[need - 1];
+            need -= primes.size();
+            lo += aWindow;
+        }
+    }
+};
+
+// Partial result of one shard [lo, hi), 96 bytes on disk
+// Sieve shards hold the prime count, a checksum, the first and last prime
+// and the largest gap between consecutive primes inside the shard.
+// The checksum is the sum of SplitMix64(p) mod 2^64: order free, so adjacent
+// results merge by adding it. Pi shards come from two pi(x) evaluations
+// and hold no checksum or gap. planLo, planHi and chunks name the plan the
+// shard belongs to, so a merge knows the whole range it has to cover.
+// check covers every other field,
+// so a torn or corrupted record reads as missing, not as a wrong count.
+struct ShardResult {
+    enum Kind : uint8_t { Sieve, Pi };
+    
+    char magic[4] = {'S', 'H', 'R', 'D'};
+    Kind kind = Sieve;
+    uint8_t reserved[3] = {};
+    uint64_t lo = 0, hi = 0;
+    uint64_t count = 0;
+    uint64_t checksum = 0;
+    uint64_t first = 0, last = 0;   // 0 without a prime
+    uint64_t maxGap = 0;
+    uint64_t planLo = 0, planHi = 0, chunks = 0;
+    uint64_t check = 0;
+    
+    uint64_t Check() const {
+        uint64_t fields[] = {kind, lo, hi, count, checksum, first, last, maxGap, planLo, planHi, chunks};
+        uint64_t h = 0;
+        for (uint64_t x: fields)
+            h = SplitMix64(h ^ x).Next();
+        return h;
+    }
+    
+    void Seal() {
+        check = Check();
+    }
+    
+    bool Valid() const {
+        return memcmp(magic, "SHRD", 4) == 0 && kind <= Pi && lo <= hi && check == Check();
+    }
+    
+    bool SamePlan(const ShardResult& other) const {
+        return kind == other.kind && planLo == other.planLo && planHi == other.planHi && chunks == other.chunks;
+    }
+    
+    // append the adjacent result [hi, next.hi), the gap across the seam included
+    bool Merge(const ShardResult& next) {
+        if (next.lo != hi || next.kind != kind)
+            return false;
+        
+        if (kind == Sieve && last && next.first)
+            maxGap = max(maxGap, next.first - last);
+        maxGap = max(maxGap, next.maxGap);
+        first = first ? first : next.first;
+        last = next.last ? next.last : last;
+        count += next.count;
+        checksum += next.checksum;
+        hi = next.hi;
+        Seal();
+        return true;
+    }
+};
+
+static_assert(sizeof(ShardResult) == 96);
+
+// Range sharding for sieving and prime counting across nodes
+// Plan cuts [lo, hi) into chunks of equal estimated sieve cost per number,
+// about 1 + sum 1/p over the sieving primes 7 <= p <= sqrt x
+// (Mertens : ln ln sqrt x - 0.77) + one visit per sieving prime per segment
+// (pi(sqrt x) / the span of a 32 KiB segment) + 1 / ln x for each prime
+// reported. The plan only depends on (lo, hi, chunks), every node computes
+// the same one and Run takes the chunks i ≡ node (mod nodes).
+// Each finished chunk is appended to a results file and flushed to disk,
+// Run skips the chunks already in it, so a restarted node resumes
+// where it stopped. Merge joins the files of all nodes into one result.
+// Pi shards do not split the work : each one costs two pi(x) evaluations
+// near hi, more than one unsharded pi(hi), they serve to cross-check
+// the counts of the sieve shards.
+class PrimeShards {
+private:
+    static double aCost(double x) {
+        double root = sqrt(max(x, 49.0));
+        return 1 + max(0.0, log(log(root)) - 0.77) + root / log(root) / (30.0 * 32 * 1024) + 1 / log(max(x, 3.0));
+    }
+    
+    // every whole record of fd into results, whole = their bytes.
+    // a partial record can only be the tail of an interrupted append,
+    // an invalid whole one is corruption and fails the read
+    static bool aRead(int fd, const string& path, vector<ShardResult>& results, off_t& whole, string& error) {
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            error = "cannot read " + path;
+            return false;
+        }
+        
+        whole = st.st_size - st.st_size % sizeof(ShardResult);
+        for (off_t at=0; at<whole; at+=sizeof(ShardResult)) {
+            ShardResult r;
+            if (pread(fd, &r, sizeof(r), at) != (ssize_t)sizeof(r)) {
+                error = "cannot read " + path;
+                return false;
+            }
+            if (!r.Valid()) {
+                error = "corrupt record " + to_string(at / sizeof(r)) + " in " + path;
+                return false;
+            }
+            results.push_back(r);
+        }
+        return true;
+    }
+    
+    // results already in path, a partial last record is cut off
+    static bool aLoad(const string& path, vector<ShardResult>& results, string& error) {
+        int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            error = "cannot open " + path;
+            return false;
+        }
+        
+        off_t whole = 0;
+        bool ok = aRead(fd, path, results, whole, error);
+        if (ok && ftruncate(fd, whole) != 0) {
+            error = "cannot truncate " + path;
+            ok = false;
+        }
+        close(fd);
+        return ok;
+    }
+    
+public:
+    // at most chunks pieces, boundaries multiples of 30 except lo and hi
+    static vector<pair<uint64_t, uint64_t>> Plan(uint64_t lo, uint64_t hi, uint64_t chunks) {
+        const int steps = 4096;
+        vector<pair<uint64_t, uint64_t>> plan;
+        if (lo >= hi || chunks == 0)
+            return plan;
+        
+        // cumulative cost at lo + width * i / steps, midpoint rule
+        double width = hi - lo;
+        vector<double> total(steps + 1, 0);
+        for (int i=0; i<steps; i++)
+            total[i + 1] = total[i] + aCost(lo + width * (i + 0.5) / steps);
+        
+        uint64_t start = lo;
+        for (uint64_t c=1; c<=chunks; c++) {
+            uint64_t end = hi;
+            if (c < chunks) {
+                double target = total[steps] * c / chunks;
+                int i = lower_bound(total.begin(), total.end(), target) - total.begin() - 1;
+                double x = lo + width * (i + (target - total[i]) / (total[i + 1] - total[i])) / steps;
+                end = min(hi, (uint64_t)x - (uint64_t)x % 30);
+            }
+            
+            if (end > start) {
+                plan.push_back({start, end});
+                start = end;
+            }
+        }
+        return plan;
+    }
+    
+    static ShardResult SieveShard(uint64_t lo, uint64_t hi) {
+        ShardResult r;
+        r.lo = lo, r.hi = hi;
+        
+        SegmentedSieve().ForEachPrime(lo, hi, [&](uint64_t p) {
+            if (r.last)
+                r.maxGap = max(r.maxGap, p - r.last);
+            r.first = r.first ? r.first : p;
+            r.last = p;
+            r.count++;
+            r.checksum += SplitMix64(p).Next();
+        });
+        r.Seal();
+        return r;
+    }
+    
+    // pi(hi - 1) - pi(lo - 1), the boundary primes by a walk from each end,
+    // about as slow as pi(hi) twice however small the shard
+    static ShardResult PiShard(uint64_t lo, uint64_t hi) {
+        ShardResult r;
+        PrimalityTest test;
+        r.kind = ShardResult::Pi;
+        r.lo = lo, r.hi = hi;
+        r.count = hi > lo ? PrimeCounting::Pi(hi - 1) - (lo ? PrimeCounting::Pi(lo - 1) : 0) : 0;
+        
+        if (r.count) {
+            for (r.first=lo; !test.IsPrime(r.first); r.first++);
+            for (r.last=hi-1; !test.IsPrime(r.last); r.last--);
+        }
+        r.Seal();
+        return r;
+    }
+    
+    // this node's share of the plan, node < nodes, appended to path.
+    // progress(i, result) after each chunk written, false with error set
+    // on bad arguments, a corrupt results file, one holding the results
+    // of another plan or an I/O error
+    static bool Run(uint64_t lo, uint64_t hi, uint64_t chunks, ShardResult::Kind kind,
+            uint64_t node, uint64_t nodes, const string& path, string& error,
+            function<void(size_t, const ShardResult&)> progress = nullptr) {
+        if (nodes == 0 || node >= nodes) {
+            error = "node must be below nodes";
+            return false;
+        }
+        
+        vector<ShardResult> done;
+        if (!aLoad(path, done, error))
+            return false;
+        
+        ShardResult planned;
+        planned.kind = kind;
+        planned.planLo = lo, planned.planHi = hi, planned.chunks = chunks;
+        for (const ShardResult& r: done) {
+            if (!r.SamePlan(planned)) {
+                error = path + " holds results of another plan";
+                return false;
+            }
+        }
+        
+        FILE* file = fopen(path.c_str(), "ab");
+        if (!file) {
+            error = "cannot open " + path;
+            return false;
+        }
+        
+        vector<pair<uint64_t, uint64_t>> plan = Plan(lo, hi, chunks);
+        bool ok = true;
+        for (size_t i=node; i<plan.size() && ok; i+=nodes) {
+            auto [a, b] = plan[i];
+            bool finished = any_of(done.begin(), done.end(), [&](const ShardResult& r) {
+                return r.lo == a && r.hi == b;
+            });
+            if (finished)
+                continue;
+            
+            ShardResult r = kind == ShardResult::Pi ? PiShard(a, b) : SieveShard(a, b);
+            r.planLo = lo, r.planHi = hi, r.chunks = chunks;
+            r.Seal();
+            ok = fwrite(&r, sizeof(r), 1, file) == 1 && fflush(file) == 0 && fsync(fileno(file)) == 0;
+            if (ok && progress)
+                progress(i, r);
+        }
+        
+        ok = fclose(file) == 0 && ok;
+        if (!ok)
+            error = "cannot write " + path;
+        return ok;
+    }
+    
+    // the records of the files in order of lo, duplicates dropped,
+    // a partial last record ignored. merged is the adjacent run from the
+    // lowest record, all of the planned [lo, hi) when gaps, the ranges of
+    // the plan no record covers, is empty. false with error set if a file
+    // cannot be read or holds a corrupt record, there is no record,
+    // records of different plans are mixed, or two records overlap or disagree
+    static bool Merge(const vector<string>& paths, ShardResult& merged, vector<pair<uint64_t, uint64_t>>& gaps, string& error) {
+        vector<ShardResult> results;
+        for (const string& path: paths) {
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                error = "cannot open " + path;
+                return false;
+            }
+            
+            off_t whole = 0;
+            bool ok = aRead(fd, path, results, whole, error);
+            close(fd);
+            if (!ok)
+                return false;
+        }
+        
+        sort(results.begin(), results.end(), [](const ShardResult& a, const ShardResult& b) {
+            return make_pair(a.lo, a.hi) < make_pair(b.lo, b.hi);
+        });
+        
+        if (results.empty()) {
+            error = "no results to merge";
+            return false;
+        }
+        
+        merged = results[0];
+        gaps.clear();
+        bool adjacent = true;
+        if (merged.lo > merged.planLo)
+            gaps.push_back({merged.planLo, merged.lo});
+        for (size_t i=1; i<results.size(); i++) {
+            const ShardResult& r = results[i];
+            const ShardResult& previous = results[i - 1];
+            string range = "[" + to_string(r.lo) + ", " + to_string(r.hi) + ")";
+            if (!r.SamePlan(previous)) {
+                error = "results of different plans mixed at " + range;
+                return false;
+            }
+            
+            if (r.lo == previous.lo && r.hi == previous.hi) {
+                if (r.count != previous.count || r.checksum != previous.checksum) {
+                    error = "conflicting results for " + range;
+                    return false;
+                }
+                continue;
+            }
+            
+            if (r.lo < previous.hi) {
+                error = "overlapping results at " + range;
+                return false;
+            }
+            
+            if (r.lo > previous.hi) {
+                gaps.push_back({previous.hi, r.lo});
+                adjacent = false;
+            } else if (adjacent)
+                merged.Merge(r);
+        }
+        
+        if (results.back().hi < merged.planHi)
+            gaps.push_back({results.back().hi, merged.planHi});
+        return true;
+    }
+};
+
+// Prime bitmap
+// primality of every n < limit as a wheel-30 bitset in the layout of
+// SegmentedSieve, bit i of byte b stands for 30b + (i-th residue),
+// 8 candidates per byte : the full 32-bit range takes 2^32 / 30 bytes, ~143 MB.
+// Save writes a 24-byte header and the raw bytes, Open maps such a file
+// read-only, so a later process starts with an mmap instead of a sieve.
+// IsPrime is one byte load and a shift.
+class PrimeBitmap {
+private:
+    struct aHeader {
+        char magic[8];
+        uint64_t limit;
+        uint64_t bytes;
+    };
+    
+    static constexpr char aMagic[8] = {'P', 'R', 'I', 'M', 'E', '3', '0', '\n'};
+    
+    vector<uint8_t> aOwned;
+    const uint8_t* aBits = nullptr;
+    uint64_t aLimit = 0;
+    void* aMap = nullptr;
+    size_t aMapBytes = 0;
+    
+    void aRelease() {
+        if (aMap)
+            munmap(aMap, aMapBytes);
+        aMap = nullptr;
+        aMapBytes = 0;
+        aOwned.clear();
+        aOwned.shrink_to_fit();
+        aBits = nullptr;
+        aLimit = 0;
+    }
+    
+    // sieve [lo, hi) straight into the bitmap, lo multiple of 30
+    void aFill(uint64_t lo, uint64_t hi) {
+        SegmentedSieve sieve;
+        sieve.ForEachSegment(lo, hi, [&](uint64_t low, const uint8_t* segment, size_t bytes) {
+            memcpy(aOwned.data() + low / 30, segment, bytes);
+        });
+    }
+    
+public:
+    PrimeBitmap() {}
+    
+    PrimeBitmap(const PrimeBitmap&) = delete;
+    PrimeBitmap& operator= (const PrimeBitmap&) = delete;
+    
+    ~PrimeBitmap() {
+        aRelease();
+    }
+    
+    void Build(uint64_t limit) {
+        aRelease();
+        aOwned.assign((limit + 29) / 30, 0);
+        aFill(0, limit);
+        aBits = aOwned.data();
+        aLimit = limit;
+    }
+    
+    // chunks of whole bytes are sieved in parallel into disjoint slices
+    void Build(uint64_t limit, WorkStealingPool& pool) {
+        const uint64_t chunk = 30ULL << 22;
+        
+        aRelease();
+        aOwned.assign((limit + 29) / 30, 0);
+        pool.ParallelFor((limit + chunk - 1) / chunk, [&](size_t c) {
+            aFill(c * chunk, min(limit, (c + 1) * chunk));
+        });
+        aBits = aOwned.data();
+        aLimit = limit;
+    }
+    
+    bool Save(const string& path) const {
+        FILE* file = fopen(path.c_str(), "wb");
+        if (!file)
+            return false;
+        
+        aHeader header;
+        memcpy(header.magic, aMagic, 8);
+        header.limit = aLimit;
+        header.bytes = Bytes();
+        
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                fwrite(aBits, 1, header.bytes, file) == header.bytes;
+        return fclose(file) == 0 && ok;
+    }
+    
+    // false when the file is missing, truncated or not a prime bitmap
+    bool Open(const string& path) {
+        aRelease();
+        
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        
+        struct stat st;
+        aHeader header;
+        bool ok = fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(header) &&
+                pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+                memcmp(header.magic, aMagic, 8) == 0 &&
+                header.bytes == (header.limit + 29) / 30 &&
+                (uint64_t)st.st_size == sizeof(header) + header.bytes;
+        
+        if (ok) {
+            aMapBytes = st.st_size;
+            aMap = mmap(nullptr, aMapBytes, PROT_READ, MAP_SHARED, fd, 0);
+            ok = aMap != MAP_FAILED;
+            if (!ok)
+                aMap = nullptr;
+        }
+        close(fd);
+        
+        if (!ok) {
+            aRelease();
+            return false;
+        }
+        
+        aBits = (const uint8_t*)aMap + sizeof(header);
+        aLimit = header.limit;
+        return true;
+    }
+    
+    uint64_t Limit() const {
+        return aLimit;
+    }
+    
+    size_t Bytes() const {
+        return (aLimit + 29) / 30;
+    }
+    
+    const uint8_t* Data() const {
+        return aBits;
+    }
+    
+    // n < Limit()
+    bool IsPrime(uint64_t n) const {
+        if (n < 6)
+            return n == 2 || n == 3 || n == 5;
+        
+        int bit = SegmentedSieve::WheelBit(n);
+        return bit >= 0 && ((aBits[n / 30] >> bit) & 1);
+    }
+};
+
+// Verdict cache
+// fixed-size, open addressing over groups of aWays slots, one 64-byte line each.
+// a slot is two relaxed words, key = n and tag = (fingerprint of n) | verdict,
+// no lock anywhere : a slot torn by racing writers fails either the key or the
+// 63-bit fingerprint check and reads as a miss, never as a wrong verdict.
+// eviction is CLOCK inside the group : a hit sets its reference bit, an insert
+// takes the first unreferenced slot from the shard's hand, clearing bits it passes.
+// the shards only spread the hands, a hand per aShardGroups groups.
+class VerdictCache {
+private:
+    static const int aWays = 4;
+    static const size_t aShardGroups = 1024;
+    
+    struct alignas(64) aGroup {
+        atomic<uint64_t> key[aWays];
+        atomic<uint64_t> tag[aWays];
+    };
+    
+    struct alignas(64) aHand {
+        atomic<uint32_t> position{0};
+    };
+    
+    unique_ptr<aGroup[]> aGroups;
+    unique_ptr<atomic<uint8_t>[]> aReferenced;
+    unique_ptr<aHand[]> aHands;
+    size_t aGroupCount;
+    int aGroupShift;
+    
+    static uint64_t aMix(uint64_t n) {
+        return SplitMix64(n).Next();
+    }
+    
+    size_t aGroupOf(uint64_t mix) const {
+        return aGroupShift == 64 ? 0 : mix >> aGroupShift;
+    }
+    
+public:
+    // slots rounded up to a power of two groups
+    VerdictCache(size_t slots = 1 << 20) {
+        aGroupCount = 1;
+        aGroupShift = 64;
+        while (aGroupCount * aWays < slots) {
+            aGroupCount *= 2;
+            aGroupShift--;
+        }
+        
+        aGroups.reset(new aGroup[aGroupCount]);
+        aReferenced.reset(new atomic<uint8_t>[aGroupCount * aWays]);
+        aHands.reset(new aHand[(aGroupCount + aShardGroups - 1) / aShardGroups]);
+        Clear();
+    }
+    
+    size_t Capacity() const {
+        return aGroupCount * aWays;
+    }
+    
+    // not safe against concurrent use
+    void Clear() {
+        for (size_t g=0; g<aGroupCount; g++) {
+            for (int w=0; w<aWays; w++) {
+                aGroups[g].key[w].store(0, memory_order_relaxed);
+                aGroups[g].tag[w].store(0, memory_order_relaxed);
+                aReferenced[g * aWays + w].store(0, memory_order_relaxed);
+            }
+        }
+    }
+    
+    bool Lookup(uint64_t n, bool& prime) const {
+        uint64_t mix = aMix(n);
+        size_t g = aGroupOf(mix);
+        const aGroup& group = aGroups[g];
+        
+        // every way of the line is compared, no branch on which one matches
+        unsigned match = 0;
+        uint64_t tags[aWays];
+        for (int w=0; w<aWays; w++) {
+            tags[w] = group.tag[w].load(memory_order_relaxed);
+            match |= (unsigned)(((tags[w] | 1) == (mix | 1)) & (group.key[w].load(memory_order_relaxed) == n)) << w;
+        }
+        
+        if (match == 0) {
+            PRIMALITY_COUNT(CacheMiss, 1);
+            return false;
+        }
+        
+        int w = __builtin_ctz(match);
+        atomic<uint8_t>& referenced = aReferenced[g * aWays + w];
+        if (!referenced.load(memory_order_relaxed))
+            referenced.store(1, memory_order_relaxed);
+        
+        prime = tags[w] & 1;
+        PRIMALITY_COUNT(CacheHit, 1);
+        return true;
+    }
+    
+    void Insert(uint64_t n, bool prime) {
+        uint64_t mix = aMix(n);
+        size_t g = aGroupOf(mix);
+        aGroup& group = aGroups[g];
+        
+        // the same key is overwritten in place
+        int victim = -1;
+        for (int w=0; w<aWays && victim<0; w++) {
+            if (group.key[w].load(memory_order_relaxed) == n)
+                victim = w;
+        }
+        
+        if (victim < 0) {
+            uint32_t start = aHands[g / aShardGroups].position.fetch_add(1, memory_order_relaxed);
+            for (int i=0; i<2*aWays && victim<0; i++) {
+                int w = (start + i) % aWays;
+                atomic<uint8_t>& referenced = aReferenced[g * aWays + w];
+                if (referenced.load(memory_order_relaxed))
+                    referenced.store(0, memory_order_relaxed);
+                else
+                    victim = w;
+            }
+            victim = victim < 0 ? start % aWays : victim;
+        }
+        
+        // a reader between the stores sees a key / tag mismatch
+        group.key[victim].store(n, memory_order_relaxed);
+        group.tag[victim].store((mix & ~1ULL) | prime, memory_order_relaxed);
+        aReferenced[g * aWays + victim].store(0, memory_order_relaxed);
+    }
+    
+    // the verdicts of the odd n in [lo, hi) below the bitmap's limit
+    void Preload(const PrimeBitmap& bitmap, uint64_t lo, uint64_t hi) {
+        hi = min(hi, bitmap.Limit());
+        for (uint64_t n=lo|1; n<hi; n+=2)
+            Insert(n, bitmap.IsPrime(n));
+    }
+    
+    // the dispatcher behind the cache, n below its lookup table skip the cache
+    bool IsPrime(uint64_t n, PrimalityTest& test) {
+        if (n < SmallPrimeBitmap::limit || n%2 == 0)
+            return test.IsPrime(n);
+        
+        bool prime;
+        if (Lookup(n, prime))
+            return prime;
+        
+        prime = test.IsPrime(n);
+        Insert(n, prime);
+        return prime;
+    }
+};
+
+// Benchmark mode, "--bench"
+// ns/call and calls/sec of every primality test per input distribution :
+// random odd, prime, semiprime and Carmichael numbers, over a bit-size sweep.
+// Every row runs the whole sample repeatedly until aBudget has elapsed,
+// "primes" is the share of the sample reported prime, as a sanity check.
+class PrimalityBenchmark {
+private:
+    PrimalityTest aTest;
+    Xoshiro256 aRandom;
+    
+    static const int aSample = 256;
+    static constexpr double aBudget = 0.05;
+    
+    // width of the 64-bit rows
+    static constexpr int aBits[] = {8, 16, 24, 32, 40, 48, 56, 64};
+    
+    vector<uint64_t> aInputs(const string& kind, int bits, const vector<uint64_t>& carmichaels) {
+        vector<uint64_t> inputs;
+        if (kind == "carmichael") {
+            for (uint64_t c: carmichaels) {
+                int width = 64 - __builtin_clzll(c);
+                if (width > bits - 8 && width <= bits)
+                    inputs.push_back(c);
+            }
+            return inputs;
+        }
+        
+        for (int i=0; i<aSample; i++) {
+            if (kind == "odd")
+                inputs.push_back(aRandom.Odd(bits));
+            else if (kind == "prime")
+                inputs.push_back(aTest.RandomPrime(bits));
+            else
+                inputs.push_back(aTest.RandomPrime(bits / 2) * aTest.RandomPrime(bits - bits / 2));
+        }
+        return inputs;
+    }
+    
+    // f(sample) returns how many it reported prime
+    template<class T, class F>
+    void aMeasure(const char* method, const char* kind, int bits, const vector<T>& inputs, F f) {
+        if (inputs.empty())
+            return;
+        
+        auto start = chrono::steady_clock::now();
+        double elapsed = 0;
+        uint64_t calls = 0, primes = 0;
+        while (elapsed < aBudget) {
+            primes = f(inputs);
+            calls += inputs.size();
+            elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        }
+        
+        printf("%-34s %-11s %5d %12.1f %14.0f %7.3f\n", method, kind, bits,
+                elapsed * 1e9 / calls, calls / elapsed, (double)primes / inputs.size());
+        fflush(stdout);
+    }
+    
+    // one call per input through SetTestNumber
+    template<class F>
+    void aMeasureEach(const char* method, const char* kind, int bits, const vector<uint64_t>& inputs, F test) {
+        aMeasure(method, kind, bits, inputs, [&](const vector<uint64_t>& sample) {
+            uint64_t primes = 0;
+            for (uint64_t n: sample) {
+                aTest.SetTestNumber(n);
+                primes += test();
+            }
+            return primes;
+        });
+    }
+    
+    template<int L>
+    void aRunBig(int bits) {
+        vector<BigUInt<L>> odd, prime;
+        for (int i=0; i<aSample / 8; i++) {
+            odd.push_back(aTest.template RandomOdd<L>(bits));
+            prime.push_back(aTest.template RandomProbablePrime<L>(bits));
+        }
+        
+        for (auto [kind, inputs]: {pair<const char*, vector<BigUInt<L>>&>{"odd", odd}, {"prime", prime}}) {
+            aMeasure("MillerRabinPrimalityTest(n, 20)", kind, bits, inputs, [&](const vector<BigUInt<L>>& sample) {
+                uint64_t primes = 0;
+                for (const BigUInt<L>& n: sample)
+                    primes += aTest.MillerRabinPrimalityTest(n, 20);
+                return primes;
+            });
+            aMeasure("BailliePSWPrimalityTest(n)", kind, bits, inputs, [&](const vector<BigUInt<L>>& sample) {
+                uint64_t primes = 0;
+                for (const BigUInt<L>& n: sample)
+                    primes += aTest.BailliePSWPrimalityTest(n);
+                return primes;
+            });
+        }
+    }
+    
+public:
+    PrimalityBenchmark(uint64_t seed = 1) : aTest(seed) {
+        aRandom.Seed(seed);
+    }
+    
+    // the Chernick Carmichael numbers (6k+1)(12k+1)(18k+1) below 2^64
+    static vector<uint64_t> Carmichaels() {
+        vector<uint64_t> c = {561, 1105, 2465, 2821, 6601, 8911};
+        for (uint64_t k=1; k<=240000; k++) {
+            uint64_t a = 6 * k + 1, b = 12 * k + 1, d = 18 * k + 1;
+            if (PrimalityTest::ConstexprPrimalityTest(a) && PrimalityTest::ConstexprPrimalityTest(b)
+                    && PrimalityTest::ConstexprPrimalityTest(d) && (uint128)a * b * d <= UINT64_MAX)
+                c.push_back(a * b * d);
+        }
+        return c;
+    }
+    
+    void Run() {
+        printf("%-34s %-11s %5s %12s %14s %7s\n", "method", "input", "bits", "ns/call", "calls/sec", "primes");
+        
+        vector<uint64_t> carmichaels = Carmichaels();
+        for (const char* kind: {"odd", "prime", "semiprime", "carmichael"}) {
+            for (int bits: aBits) {
+                vector<uint64_t> inputs = aInputs(kind, bits, carmichaels);
+                
+                // trial division is O(sqrt n)
+                if (bits <= 32)
+                    aMeasureEach("SimplePrimalityTest", kind, bits, inputs, [&] { return aTest.SimplePrimalityTest(); });
+                if (bits <= 40)
+                    aMeasureEach("SimplePrimalityTestOptimize", kind, bits, inputs, [&] { return aTest.SimplePrimalityTestOptimize(); });
+                
+                aMeasureEach("FermatsPrimalityTest", kind, bits, inputs, [&] { return aTest.FermatsPrimalityTest(); });
+                aMeasureEach("StrongFermatsPrimalityTest", kind, bits, inputs, [&] { return aTest.StrongFermatsPrimalityTest(); });
+                aMeasureEach("SolovayStrassenPrimalityTest(10)", kind, bits, inputs, [&] { return aTest.SolovayStrassenPrimalityTest(10); });
+                aMeasureEach("MillerRabinPrimalityTest", kind, bits, inputs, [&] { return aTest.MillerRabinPrimalityTest(); });
+                aMeasureEach("BailliePSWPrimalityTest", kind, bits, inputs, [&] { return aTest.BailliePSWPrimalityTest(); });
+                aMeasure("IsPrime", kind, bits, inputs, [&](const vector<uint64_t>& sample) {
+                    uint64_t primes = 0;
+                    for (uint64_t n: sample)
+                        primes += aTest.IsPrime(n);
+                    return primes;
+                });
+                aMeasureEach("ConstexprPrimalityTest", kind, bits, inputs, [&] { return PrimalityTest::ConstexprPrimalityTest(aTest.GetTestNumber()); });
+                
+                aMeasure("BatchPrimalityTest", kind, bits, inputs, [&](const vector<uint64_t>& sample) {
+                    vector<uint8_t> verdicts(sample.size());
+                    aTest.BatchPrimalityTest(sample, verdicts);
+                    return (uint64_t)count(verdicts.begin(), verdicts.end(), 1);
+                });
+            }
+        }
+        
+        // Wilson's theorem only holds up in 64 bits for n <= 20
+        vector<uint64_t> tiny;
+        for (uint64_t n=2; n<=20; n++)
+            tiny.push_back(n);
+        aMeasureEach("WilsonsPrimalityTest", "all", 5, tiny, [&] { return aTest.WilsonsPrimalityTest(); });
+        
+        aRunBig<2>(128);
+        aRunBig<4>(256);
+        aRunBig<8>(512);
+        aRunBig<16>(1024);
+    }
+};
+
+// Regression mode, "--verify"
+// every primality test against corpora of known answers : all n < 2^18,
+// random odd numbers, primes and semiprimes per bit size, the base-2 strong
+// pseudoprimes, Carmichael numbers, windows around 2^31, 2^32, 2^62, 2^63
+// and below 2^64, and multi-limb numbers of known primality.
+// The truth is aReference, Miller-Rabin by plain 128-bit % to the first 12
+// prime bases, exact below 3.18 * 10^23 and sharing no code with the kernels.
+// A prime reported composite is always a mismatch, so is a composite reported
+// prime by a deterministic test, the Fermat, strong Fermat and Solovay-Strassen
+// tests may pass pseudoprimes and those are only counted.
+// ns/call of every method and corpus is compared to a baseline file of
+// "method corpus ns" lines, a slowdown above the tolerance fails as well.
+// PrimalityBaseline.txt next to this file is the committed one,
+// re-recorded with --record on the machine the numbers are kept for.
+class PrimalityVerify {
+private:
+    struct aCorpus {
+        string name;
+        vector<uint64_t> numbers;
+        vector<uint8_t> truth;
+    };
+    
+    // verdicts 0 / 1, or 2 for a factorization that does not multiply back to n
+    struct aMethod {
+        const char* name;
+        bool deterministic;
+        function<bool(uint64_t)> eligible;
+        function<void(span<const uint64_t>, span<uint8_t>)> run;
+    };
+    
+    // "2^k-c" or decimal
+    struct aBigCase {
+        const char* text;
+        bool prime;
+    };
+    
+    PrimalityTest aTest;
+    Xoshiro256 aRandom;
+    PrimeTable aPrimes;
+    FactorTable aFactors;
+    vector<aCorpus> aCorpora;
+    map<string, double> aBaseline;
+    vector<pair<string, double>> aResults;
+    double aTolerance = 0.25;
+    int aFailures = 0;
+    bool aChecking = false;
+    
+    static const int aPasses = 3;
+    static constexpr double aBudget = 0.05;
+    static constexpr uint64_t aTrialLimit = 1ULL << 36;
+    
+    static uint64_t aPowMod(uint64_t a, uint64_t e, uint64_t n) {
+        uint64_t r = 1;
+        for (a%=n; e>0; e>>=1) {
+            if (e & 1)
+                r = (uint128)r * a % n;
+            a = (uint128)a * a % n;
+        }
+        return r;
+    }
+    
+    static bool aStrongProbablePrime(uint64_t n, uint64_t a) {
+        uint64_t d = n - 1;
+        int s = __builtin_ctzll(d);
+        d >>= s;
+        
+        uint64_t x = aPowMod(a, d, n);
+        if (x == 1 || x == n - 1)
+            return true;
+        
+        for (int r=1; r<s; r++) {
+            x = (uint128)x * x % n;
+            if (x == n - 1)
+                return true;
+        }
+        return false;
+    }
+    
+    static bool aReference(uint64_t n) {
+        static const uint64_t bases[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+        if (n < 2)
+            return false;
+        
+        for (uint64_t p: bases) {
+            if (n%p == 0)
+                return n == p;
+        }
+        
+        for (uint64_t a: bases) {
+            if (!aStrongProbablePrime(n, a))
+                return false;
+        }
+        return true;
+    }
+    
+    // trial division ends within 4096 steps
+    static bool aSmallFactor(uint64_t n) {
+        for (uint64_t p=2; p<4096 && p<n; p++) {
+            if (n%p == 0)
+                return true;
+        }
+        return false;
+    }
+    
+    void aAdd(const string& name, const vector<uint64_t>& numbers) {
+        aCorpus corpus;
+        corpus.name = name;
+        corpus.numbers = numbers;
+        for (uint64_t n: numbers)
+            corpus.truth.push_back(aReference(n));
+        aCorpora.push_back(corpus);
+    }
+    
+    void aBuildCorpora() {
+        vector<uint64_t> small(1 << 18);
+        for (uint64_t n=0; n<small.size(); n++)
+            small[n] = n;
+        aAdd("small", small);
+        
+        vector<uint64_t> random;
+        for (int bits: {24, 32, 40, 48, 56, 64}) {
+            for (int i=0; i<1024; i++)
+                random.push_back(aRandom.Odd(bits));
+            for (int i=0; i<256; i++) {
+                random.push_back(aTest.RandomPrime(bits));
+                random.push_back(aTest.RandomPrime(bits / 2) * aTest.RandomPrime(bits - bits / 2));
+            }
+        }
+        aAdd("random", random);
+        
+        // below 2^20 by search, then the least strong pseudoprimes to the
+        // first 4 to 9 prime bases (OEIS A014233)
+        vector<uint64_t> spsp;
+        for (uint64_t n=3; n<(1 << 20); n+=2) {
+            if (aStrongProbablePrime(n, 2) && !aReference(n))
+                spsp.push_back(n);
+        }
+        for (uint64_t n: {3215031751ULL, 2152302898747ULL, 3474749660383ULL, 341550071728321ULL, 3825123056546413051ULL})
+            spsp.push_back(n);
+        aAdd("spsp2", spsp);
+        
+        aAdd("carmichael", PrimalityBenchmark::Carmichaels());
+        
+        vector<uint64_t> boundary = {0, 1, 2, 3, 4};
+        for (uint64_t b: {1ULL << 31, 1ULL << 32, 1ULL << 62, 1ULL << 63}) {
+            for (uint64_t n=b-512; n<b+512; n++)
+                boundary.push_back(n);
+        }
+        for (uint64_t n=UINT64_MAX-1023; n!=0; n++)
+            boundary.push_back(n);
+        aAdd("boundary", boundary);
+    }
+    
+    // one call per input through SetTestNumber
+    template<class F>
+    static function<void(span<const uint64_t>, span<uint8_t>)> aEach(PrimalityTest& test, F f) {
+        return [&test, f](span<const uint64_t> numbers, span<uint8_t> verdicts) {
+            for (size_t i=0; i<numbers.size(); i++) {
+                test.SetTestNumber(numbers[i]);
+                verdicts[i] = f();
+            }
+        };
+    }
+    
+    // prime iff the one factor is n, the factors are proven prime on the checked pass only
+    uint8_t aFactorVerdict(uint64_t n, const vector<uint64_t>& factors) const {
+        uint128 product = 1;
+        for (uint64_t p: factors) {
+            product *= p;
+            if (product > n || (aChecking && !aReference(p)))
+                return 2;
+        }
+        if (n >= 2 && product != n)
+            return 2;
+        return factors.size() == 1;
+    }
+    
+    vector<aMethod> aMethods() {
+        auto all = [](uint64_t) { return true; };
+        auto trial = [](uint64_t n) { return n < aTrialLimit || aSmallFactor(n); };
+        PrimalityTest& t = aTest;
+        
+        return {
+            {"SimplePrimalityTest", true, trial, aEach(t, [&t] { return t.SimplePrimalityTest(); })},
+            {"SimplePrimalityTest(table)", true, trial, aEach(t, [&t, this] { return t.SimplePrimalityTest(aPrimes); })},
+            {"SimplePrimalityTestOptimize", true, trial, aEach(t, [&t] { return t.SimplePrimalityTestOptimize(); })},
+            {"WilsonsPrimalityTest", true, [](uint64_t n) { return n <= 20; }, aEach(t, [&t] { return t.WilsonsPrimalityTest(); })},
+            {"FermatsPrimalityTest", false, all, aEach(t, [&t] { return t.FermatsPrimalityTest(); })},
+            {"StrongFermatsPrimalityTest", false, all, aEach(t, [&t] { return t.StrongFermatsPrimalityTest(); })},
+            {"SolovayStrassenPrimalityTest(10)", false, all, aEach(t, [&t] { return t.SolovayStrassenPrimalityTest(10); })},
+            {"MillerRabinPrimalityTest", true, all, aEach(t, [&t] { return t.MillerRabinPrimalityTest(); })},
+            {"BailliePSWPrimalityTest", true, all, aEach(t, [&t] { return t.BailliePSWPrimalityTest(); })},
+            {"ConstexprPrimalityTest", true, all, aEach(t, [&t] { return PrimalityTest::ConstexprPrimalityTest(t.GetTestNumber()); })},
+            {"IsPrime", true, all, [&t](span<const uint64_t> numbers, span<uint8_t> verdicts) {
+                for (size_t i=0; i<numbers.size(); i++)
+                    verdicts[i] = t.IsPrime(numbers[i]);
+            }},
+            {"BatchPrimalityTest", true, all, [&t](span<const uint64_t> numbers, span<uint8_t> verdicts) {
+                t.BatchPrimalityTest(numbers, verdicts);
+            }},
+            {"Factorize", true, all, [&t, this](span<const uint64_t> numbers, span<uint8_t> verdicts) {
+                for (size_t i=0; i<numbers.size(); i++) {
+                    t.SetTestNumber(numbers[i]);
+                    verdicts[i] = aFactorVerdict(numbers[i], t.Factorize());
+                }
+            }},
+            {"FactorizeSmall", true, [this](uint64_t n) { return n >= 1 && n < aFactors.Limit(); },
+                    [this](span<const uint64_t> numbers, span<uint8_t> verdicts) {
+                vector<uint64_t> factors;
+                for (size_t i=0; i<numbers.size(); i++) {
+                    factors.clear();
+                    aFactors.FactorizeSmall(numbers[i], factors);
+                    verdicts[i] = aFactorVerdict(numbers[i], factors);
+                }
+            }},
+        };
+    }
+    
+    // ns/call of the fastest of at least aPasses passes over inputs numbers,
+    // more while aBudget lasts. the minimum is what a shared machine disturbs least
+    template<class F>
+    static double aFastest(size_t inputs, F pass) {
+        auto start = chrono::steady_clock::now();
+        double best = INFINITY;
+        for (int i=0; i<aPasses || chrono::steady_clock::now() - start < chrono::duration<double>(aBudget); i++) {
+            auto begin = chrono::steady_clock::now();
+            pass();
+            best = min(best, chrono::duration<double, nano>(chrono::steady_clock::now() - begin).count());
+        }
+        return best / inputs;
+    }
+    
+    // one result row, returns false on a failure
+    bool aReport(const string& method, const string& corpus, size_t inputs, uint64_t mismatches, uint64_t pseudoprimes, double ns) {
+        string key = method + " " + corpus;
+        aResults.push_back({key, ns});
+        
+        auto base = aBaseline.find(key);
+        double delta = base == aBaseline.end() ? 0 : ns / base->second - 1;
+        bool slow = delta > aTolerance;
+        
+        printf("%-34s %-11s %8zu %10llu %10llu %12.1f", method.c_str(), corpus.c_str(), inputs,
+                (unsigned long long)mismatches, (unsigned long long)pseudoprimes, ns);
+        if (base != aBaseline.end())
+            printf(" %12.1f %+7.1f%%%s", base->second, 100 * delta, slow ? " SLOWER" : "");
+        printf("\n");
+        fflush(stdout);
+        
+        return mismatches == 0 && !slow;
+    }
+    
+    // one checked pass, then the timed ones
+    void aRun(const aMethod& method, const aCorpus& corpus) {
+        vector<uint64_t> numbers;
+        vector<uint8_t> truth;
+        for (size_t i=0; i<corpus.numbers.size(); i++) {
+            if (method.eligible(corpus.numbers[i])) {
+                numbers.push_back(corpus.numbers[i]);
+                truth.push_back(corpus.truth[i]);
+            }
+        }
+        if (numbers.empty())
+            return;
+        
+        vector<uint8_t> verdicts(numbers.size());
+        uint64_t mismatches = 0, pseudoprimes = 0;
+        
+        aChecking = true;
+        method.run(numbers, verdicts);
+        aChecking = false;
+        for (size_t i=0; i<numbers.size(); i++) {
+            if (verdicts[i] == truth[i])
+                continue;
+            
+            if (!method.deterministic && verdicts[i] == 1) {
+                pseudoprimes++;
+                continue;
+            }
+            
+            if (mismatches++ < 4)
+                fprintf(stderr, "%s(%llu) = %d, expected %d\n", method.name, (unsigned long long)numbers[i], verdicts[i], truth[i]);
+        }
+        
+        double ns = aFastest(numbers.size(), [&] { method.run(numbers, verdicts); });
+        aFailures += !aReport(method.name, corpus.name, numbers.size(), mismatches, pseudoprimes, ns);
+    }
+    
+    template<int L>
+    static BigUInt<L> aParse(const string& text) {
+        size_t caret = text.find('^');
+        if (caret == string::npos)
+            return BigUInt<L>::FromString(text);
+        
+        // 2^k wraps to 0 at k = 64 L, 0 - c is still 2^k - c
+        int k = stoi(text.substr(caret + 1));
+        BigUInt<L> x;
+        if (k < 64 * L)
+            x.SetBit(k);
+        return x - BigUInt<L>(strtoull(text.c_str() + text.find('-') + 1, nullptr, 10));
+    }
+    
+    // the multi-limb tests over the cases that need L limbs
+    template<int L>
+    void aRunBig(const vector<aBigCase>& cases, int minBits) {
+        vector<BigUInt<L>> numbers;
+        vector<uint8_t> truth;
+        for (const aBigCase& c: cases) {
+            BigUInt<L> n = aParse<L>(c.text);
+            int bits = c.text[0] == '2' && c.text[1] == '^' ? stoi(c.text + 2) : n.BitLength();
+            if (bits > minBits && bits <= 64 * L) {
+                numbers.push_back(n);
+                truth.push_back(c.prime);
+            }
+        }
+        if (numbers.empty())
+            return;
+        
+        string corpus = "multilimb" + to_string(64 * L);
+        auto run = [&](const string& name, auto test) {
+            uint64_t mismatches = 0;
+            for (size_t i=0; i<numbers.size(); i++) {
+                bool prime = test(numbers[i]);
+                if (prime != truth[i] && mismatches++ < 4)
+                    fprintf(stderr, "%s(%s) = %d, expected %d\n", name.c_str(), numbers[i].ToString().c_str(), prime, truth[i]);
+            }
+            
+            volatile uint64_t primes = 0;
+            double ns = aFastest(numbers.size(), [&] {
+                for (const BigUInt<L>& n: numbers)
+                    primes = primes + test(n);
+            });
+            aFailures += !aReport(name, corpus, numbers.size(), mismatches, 0, ns);
+        };
+        
+        run("MillerRabinPrimalityTest(n,20)", [&](const BigUInt<L>& n) { return aTest.MillerRabinPrimalityTest(n, 20); });
+        run("BailliePSWPrimalityTest(n)", [&](const BigUInt<L>& n) { return aTest.BailliePSWPrimalityTest(n); });
+        run("IsPrime(n)", [&](const BigUInt<L>& n) { return aTest.IsPrime(n); });
+    }
     
-    long long aGCD (long long n1, long long n2) {
-        long long temp;
-        while (n2 != 0) {
-            temp = n1;
-            n1 = n2;
-            n2 = temp % n2;
+    // random primes below the full width keep their random bits :
+    // two draws differ, have exactly bits bits and pass Baillie-PSW
+    template<int L>
+    void aRunRandomPrimes(int bits) {
+        const int draws = 8;
+        vector<BigUInt<L>> primes;
+        double ns = aFastest(draws, [&] {
+            primes.clear();
+            for (int i=0; i<draws; i++)
+                primes.push_back(aTest.template RandomProbablePrime<L>(bits));
+        });
+        
+        uint64_t mismatches = 0;
+        for (int i=0; i<draws; i++) {
+            bool bad = primes[i].BitLength() != bits || !aTest.BailliePSWPrimalityTest(primes[i]) ||
+                    (i > 0 && primes[i] == primes[i - 1]);
+            if (bad && mismatches++ < 4)
+                fprintf(stderr, "RandomProbablePrime<%d>(%d) = %s\n", L, bits, primes[i].ToString().c_str());
         }
-        return n1;
+        aFailures += !aReport("RandomProbablePrime", "bits" + to_string(bits), draws, mismatches, 0, ns);
     }
     
-    long long aPOW (long long base, long long exponent, long long modulus) {
-        long long result = 1;
-        while (exponent > 0) {
-            if (exponent % 2 == 1)
-                result = (result * base) % modulus;
+    // the segmented sieve over windows of 2^16 against IsPrime, the last one
+    // ends at 2^64 - 1 where multiples and segment ends would wrap.
+    // one timed pass, the top window alone sieves the 2 * 10^8 primes below 2^32
+    void aRunSieve() {
+        const uint64_t width = 1 << 16;
+        SegmentedSieve sieve;
+        const pair<const char*, uint64_t> windows[] = {
+            {"0", 0}, {"2^32", (1ULL << 32) - width / 2}, {"2^63", (1ULL << 63) - width / 2}, {"2^64", UINT64_MAX - width}
+        };
+        for (auto [name, lo]: windows) {
+            uint64_t hi = lo + width;
+            vector<uint64_t> primes;
+            auto start = chrono::steady_clock::now();
+            sieve.ForEachPrime(lo, hi, [&](uint64_t p) {
+                primes.push_back(p);
+            });
+            double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / width;
             
-            base = (base * base) % modulus;
+            uint64_t mismatches = 0;
+            size_t next = 0;
+            for (uint64_t n=lo; n<hi; n++) {
+                bool listed = next < primes.size() && primes[next] == n;
+                next += listed;
+                if (listed != aTest.IsPrime(n) && mismatches++ < 4)
+                    fprintf(stderr, "SegmentedSieve [%llu, %llu) : %llu %s\n", (unsigned long long)lo,
+                            (unsigned long long)hi, (unsigned long long)n, listed ? "listed" : "missing");
+            }
+            mismatches += primes.size() - next;
+            aFailures += !aReport("SegmentedSieve", string("window") + name, width, mismatches, 0, ns);
+        }
+    }
+    
+    // the Karatsuba path of LimbMultiply against the schoolbook product,
+    // no BigUInt width built here reaches its threshold. 97 limbs split
+    // unevenly, the all-ones first operands carry the most
+    void aRunKaratsuba() {
+        const int trials = 64;
+        for (int n: {48, 64, 97}) {
+            vector<uint64_t> a(n), b(n), product(2 * n), expected(2 * n), scratch(LimbMultiply::ScratchLimbs(n));
+            uint64_t mismatches = 0;
+            for (int t=0; t<trials; t++) {
+                for (int i=0; i<n; i++) {
+                    a[i] = t ? aRandom.Next() : UINT64_MAX;
+                    b[i] = t ? aRandom.Next() : UINT64_MAX;
+                }
+                LimbMultiply::Mul(a.data(), b.data(), n, product.data(), scratch.data());
+                LimbMultiply::Schoolbook(a.data(), b.data(), n, expected.data());
+                if (product != expected && mismatches++ < 4)
+                    fprintf(stderr, "LimbMultiply::Mul %d limbs, trial %d : differs from the schoolbook product\n", n, t);
+            }
             
-            exponent /= 2;
+            double ns = aFastest(trials, [&] {
+                for (int t=0; t<trials; t++)
+                    LimbMultiply::Mul(a.data(), b.data(), n, product.data(), scratch.data());
+            });
+            aFailures += !aReport("LimbMultiply::Mul", "limbs" + to_string(n), trials, mismatches, 0, ns);
         }
-        return result;
+    }
+    
+    void aRunBig() {
+        static const vector<aBigCase> cases = {
+            {"2^61-1", true}, {"2^64-59", true}, {"2^64-1", false},
+            {"2^89-1", true}, {"2^107-1", true}, {"2^127-1", true}, {"2^67-1", false},
+            {"2^128-159", true}, {"2^128-1", false},
+            {"318665857834031151167461", false}, {"3317044064679887385961981", false},
+            {"1427247692705959880439315947500961989719490561", false},
+            {"340282366920938460843936948965011886881", false},
+            {"2^256-189", true}, {"2^512-569", true}, {"2^521-1", true},
+            {"2^607-1", true}, {"2^1024-105", true}, {"2^1024-1", false},
+        };
+        
+        aRunBig<2>(cases, 0);
+        aRunBig<4>(cases, 128);
+        aRunBig<8>(cases, 256);
+        aRunBig<16>(cases, 512);
+        
+        aRunRandomPrimes<4>(100);
+        aRunRandomPrimes<4>(128);
+        aRunRandomPrimes<4>(200);
+        aRunRandomPrimes<8>(300);
     }
     
 public:
-    void SetTestNumber(long long N) {
-        aN = N;
+    PrimalityVerify(uint64_t seed = 1) : aTest(seed) {
+        aRandom.Seed(seed);
+        aPrimes = SegmentedSieve().Table(1 << 16);
+        aFactors.Build(1 << 24);
     }
     
-    long long GetTestNumber() {
-        return aN;
+    void SetTolerance(double tolerance) {
+        aTolerance = tolerance;
     }
     
-    // Trial Division Method
-    bool SimplePrimalityTest() {
-        if (aN < 2)
+    // "method corpus ns" per line, # starts a comment
+    bool LoadBaseline(const string& path) {
+        FILE* f = fopen(path.c_str(), "r");
+        if (!f)
             return false;
         
-        if (aN==2 || aN==3)
-            return true;
-        
-        for (int i=2; i<=sqrt(aN); i++) {
-            if (aN%i == 0)
-                return false;
+        char line[256], method[128], corpus[64];
+        double ns;
+        while (fgets(line, sizeof(line), f)) {
+            if (line[0] != '#' && sscanf(line, "%127s %63s %lf", method, corpus, &ns) == 3)
+                aBaseline[string(method) + " " + corpus] = ns;
         }
-        
+        fclose(f);
         return true;
     }
     
-    // Optimize Trial Division Method
-    // p = 6k +- 1, (p > 3)
-    // n = 6k + i, 
-    // (6k + 0) & (6k + 2) & (6k + 4) ≡ 0 (mod 2)
-    // (6k + 3) ≡ 0 (mod 3)
-    // remain (6k - 1) & (6k + 1)
-    bool SimplePrimalityTestOptimize() {
-        if (aN==2 || aN==3)
-            return true;
-    
-        if (aN<2 || aN%2 == 0 || aN%3 == 0)
+    bool SaveBaseline(const string& path) const {
+        FILE* f = fopen(path.c_str(), "w");
+        if (!f)
             return false;
+        
+        fprintf(f, "# method corpus ns/call, written by --verify --record\n");
+        for (auto& [key, ns]: aResults)
+            fprintf(f, "%s %.1f\n", key.c_str(), ns);
+        return fclose(f) == 0;
+    }
     
-        for (int i=5; i<=sqrt(aN); i+=6) {
-            if (aN%i == 0 || aN%(i+2) == 0)
-                return false;
+    // one number per line, the first field, as in the Feitsma list of the
+    // base-2 strong pseudoprimes below 2^64
+    bool LoadPseudoprimes(const string& path) {
+        FILE* f = fopen(path.c_str(), "r");
+        if (!f)
+            return false;
+        
+        vector<uint64_t> numbers;
+        char line[256];
+        while (fgets(line, sizeof(line), f)) {
+            if (isdigit(line[0]))
+                numbers.push_back(strtoull(line, nullptr, 10));
         }
+        fclose(f);
         
+        aAdd("pseudoprimes", numbers);
         return true;
     }
     
-    // Wilson's Theorem
-    // if p is prime, (p - 1)! ≡ -1 (mod p)
-    // work on (n <= 20), 21! > 2^64
-    bool WilsonsPrimalityTest() {
-        if (aN<2 || aN>20)
-            return false;
+    // number of failed rows
+    int Run() {
+        aBuildCorpora();
         
-        long long p=1;
-        for (int i=1; i<aN; i++) 
-            p *= i;
+        printf("%-34s %-11s %8s %10s %10s %12s %12s %8s\n", "method", "corpus", "inputs", "mismatches", "pseudo", "ns/call", "baseline", "delta");
+        for (const aMethod& method: aMethods()) {
+            for (const aCorpus& corpus: aCorpora)
+                aRun(method, corpus);
+        }
+        aRunSieve();
+        aRunKaratsuba();
+        aRunBig();
         
-        if (p%aN == aN-1)
-            return true;
+        printf("%d failed\n", aFailures);
+        return aFailures;
+    }
+};
+
+// Hardware performance counters, Linux perf_event_open
+// cycles, instructions, branch misses, L1D and last level cache read misses
+// of this thread in user space, one group enabled, disabled and read together.
+// perf_event_paranoid <= 2 allows that without privileges, events the CPU or
+// the kernel refuses are left out of the group and read as unavailable.
+// Open fails off Linux, under a seccomp filter or with no event at all,
+// Error() says why and callers fall back to the wall clock.
+class PerfCounters {
+public:
+    enum Event { Cycles, Instructions, BranchMisses, L1DMisses, LLCMisses, Events };
+    
+    struct Sample {
+        uint64_t value[Events] = {};
+        bool available[Events] = {};
+        double seconds = 0;
+    };
+    
+private:
+    int aFd[Events];
+    int aSlot[Events];      // position in the group read, -1 if not opened
+    int aOpened = 0;
+    int aErrno = 0;
+    chrono::steady_clock::time_point aStart;
+    
+#if defined(__linux__)
+    static int aOpen(Event e, int group) {
+        static const uint64_t cacheRead = PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+        static const pair<uint32_t, uint64_t> config[Events] = {
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+            {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | cacheRead},
+            {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | cacheRead},
+        };
+        
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = config[e].first;
+        attr.config = config[e].second;
+        attr.disabled = group == -1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        return syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+    }
+#endif
+    
+    int aLeader() const {
+        for (int e=0; e<Events; e++) {
+            if (aSlot[e] >= 0)
+                return aFd[e];
+        }
+        return -1;
+    }
+    
+public:
+    PerfCounters() {
+        for (int e=0; e<Events; e++)
+            aFd[e] = aSlot[e] = -1;
+    }
+    
+    ~PerfCounters() {
+        for (int e=0; e<Events; e++) {
+            if (aFd[e] >= 0)
+                close(aFd[e]);
+        }
+    }
+    
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+    
+    // false if no event could be opened
+    bool Open() {
+#if defined(__linux__)
+        for (int e=0; e<Events; e++) {
+            int fd = aOpen(Event(e), aLeader());
+            if (fd < 0) {
+                aErrno = errno;
+                continue;
+            }
+            aFd[e] = fd;
+            aSlot[e] = aOpened++;
+        }
+#else
+        aErrno = ENOSYS;
+#endif
+        return aOpened > 0;
+    }
+    
+    const char* Error() const {
+        return strerror(aErrno);
+    }
+    
+    bool Available(Event e) const {
+        return aSlot[e] >= 0;
+    }
+    
+    void Start() {
+#if defined(__linux__)
+        if (aOpened > 0) {
+            ioctl(aLeader(), PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(aLeader(), PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+#endif
+        aStart = chrono::steady_clock::now();
+    }
+    
+    // counts since Start, a short read leaves every event unavailable
+    Sample Stop() {
+        Sample s;
+        s.seconds = chrono::duration<double>(chrono::steady_clock::now() - aStart).count();
+#if defined(__linux__)
+        if (aOpened == 0)
+            return s;
+        
+        ioctl(aLeader(), PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        uint64_t buffer[1 + Events];
+        ssize_t bytes = read(aLeader(), buffer, sizeof(uint64_t) * (1 + aOpened));
+        if (bytes != (ssize_t)sizeof(uint64_t) * (1 + aOpened))
+            return s;
+        
+        for (int e=0; e<Events; e++) {
+            if (aSlot[e] >= 0) {
+                s.value[e] = buffer[1 + aSlot[e]];
+                s.available[e] = true;
+            }
+        }
+#endif
+        return s;
+    }
+};
+
+// Profiling mode, "--profile"
+// the batch, sieve and factorization entry points under PerfCounters,
+// per candidate : ns, cycles, instructions, IPC, branch, L1D and LLC misses.
+// IPC well below the issue width with few misses means a dependent chain,
+// latency-bound like a single Montgomery ladder, IPC near it means
+// throughput-bound like the interleaved batch lanes. the sieve rows sweep
+// the segment size, L1D misses per number jump once a segment leaves L1.
+// without counters only the ns column is printed.
+class PrimalityProfile {
+private:
+    PrimalityTest aTest;
+    Xoshiro256 aRandom;
+    PerfCounters aCounters;
+    bool aHardware = false;
+    
+    static const int aCandidates = 1 << 16;
+    
+    // one run of f over candidates inputs, f returns a checksum kept alive
+    template<class F>
+    void aMeasure(const string& name, uint64_t candidates, F f) {
+        aCounters.Start();
+        volatile uint64_t sink = f();
+        (void)sink;
+        PerfCounters::Sample s = aCounters.Stop();
+        
+        printf("%-36s %10llu %10.1f", name.c_str(), (unsigned long long)candidates, s.seconds * 1e9 / candidates);
+        for (int e=0; e<PerfCounters::Events && aHardware; e++) {
+            if (s.available[e])
+                printf(" %10.2f", (double)s.value[e] / candidates);
+            else
+                printf(" %10s", "-");
             
-        return false;
+            if (e == PerfCounters::Instructions) {
+                if (s.available[PerfCounters::Cycles] && s.available[e] && s.value[PerfCounters::Cycles])
+                    printf(" %6.2f", (double)s.value[e] / s.value[PerfCounters::Cycles]);
+                else
+                    printf(" %6s", "-");
+            }
+        }
+        printf("\n");
+        fflush(stdout);
     }
     
-    // probable prime
-    // Fermat’s little theorem
-    // a^(p-1) ≡ 1 (mod p), a != 0
-    bool FermatsPrimalityTest() {
-        if (aN == 2)
-            return true;
+public:
+    PrimalityProfile(uint64_t seed = 1) : aTest(seed) {
+        aRandom.Seed(seed);
+    }
+    
+    // false if the counters are unavailable, the rows still run
+    bool Open() {
+        aHardware = aCounters.Open();
+        return aHardware;
+    }
+    
+    const char* Error() const {
+        return aCounters.Error();
+    }
+    
+    void Run() {
+        printf("%-36s %10s %10s", "entry point", "candidates", "ns");
+        if (aHardware)
+            printf(" %10s %10s %6s %10s %10s %10s", "cycles", "instr", "IPC", "br-miss", "L1D-miss", "LLC-miss");
+        printf("\n");
         
-        if (aN<2 || aN%2 == 0)
-            return false;
+        for (int bits: {32, 64}) {
+            vector<uint64_t> numbers(aCandidates);
+            for (uint64_t& n: numbers)
+                n = aRandom.Odd(bits);
+            vector<uint8_t> verdicts(numbers.size());
+            string suffix = " " + to_string(bits) + "-bit";
+            
+            aMeasure("BatchPrimalityTest" + suffix, numbers.size(), [&] {
+                aTest.BatchPrimalityTest(numbers, verdicts);
+                return (uint64_t)count(verdicts.begin(), verdicts.end(), 1);
+            });
+            aMeasure("MillerRabinPrimalityTest" + suffix, numbers.size(), [&] {
+                uint64_t primes = 0;
+                for (uint64_t n: numbers) {
+                    aTest.SetTestNumber(n);
+                    primes += aTest.MillerRabinPrimalityTest();
+                }
+                return primes;
+            });
+            aMeasure("IsPrime" + suffix, numbers.size(), [&] {
+                uint64_t primes = 0;
+                for (uint64_t n: numbers)
+                    primes += aTest.IsPrime(n);
+                return primes;
+            });
+        }
         
-        long long ap = 1;
-        for (long long i=1; i<aN; i++) {
-            ap = (ap << 1) % aN;
+        // sieving primes built before the first row
+        uint64_t lo = 1000000000000ULL, hi = lo + 100000000;
+        SegmentedSieve sieve;
+        sieve.CountPrimes(hi - 1, hi);
+        for (size_t kib: {8, 16, 32, 64, 256, 1024, 4096}) {
+            sieve.SetSegmentBytes(kib * 1024);
+            aMeasure("CountPrimes segment " + to_string(kib) + " KiB", hi - lo, [&] {
+                return sieve.CountPrimes(lo, hi);
+            });
         }
         
-        if (ap == 1)
-            return true;
+        vector<uint64_t> semiprimes;
+        for (int bits: {32, 48, 64}) {
+            semiprimes.clear();
+            for (int i=0; i<256; i++)
+                semiprimes.push_back(aTest.RandomPrime(bits / 2) * aTest.RandomPrime(bits - bits / 2));
+            aMeasure("Factorize semiprime " + to_string(bits) + "-bit", semiprimes.size(), [&] {
+                uint64_t factors = 0;
+                for (uint64_t n: semiprimes) {
+                    aTest.SetTestNumber(n);
+                    factors += aTest.Factorize().size();
+                }
+                return factors;
+            });
+        }
         
-        return false;
+        // table of 2^24 fits the LLC of most parts, 2^28 does not
+        for (int bits: {24, 28}) {
+            FactorTable table;
+            table.Build(1ULL << bits);
+            vector<uint64_t> numbers(aCandidates), factors;
+            for (uint64_t& n: numbers)
+                n = aRandom.Next() % table.Limit() | 1;
+            
+            aMeasure("FactorizeSmall table 2^" + to_string(bits), numbers.size(), [&] {
+                uint64_t count = 0;
+                for (uint64_t n: numbers) {
+                    factors.clear();
+                    table.FactorizeSmall(n, factors);
+                    count += factors.size();
+                }
+                return count;
+            });
+        }
     }
+};
+
+// Streaming mode, "--stream"
+// candidates from stdin or an mmapped file, newline-delimited decimal or
+// binary little-endian uint64, verdicts out through one large buffer.
+// reader -> workers -> writer over a fixed set of chunk buffers :
+// the reader fills a free chunk, a worker runs the batch test on it,
+// the writer emits chunks in input order and hands them back to the reader,
+// so memory is bounded by aChunks whatever the input size.
+// the writer formats into its own buffer and hands it to fwrite in
+// blocks of aOutBytes, the stdio buffering of out is left alone.
+//   text out : "n 0" / "n 1" per candidate, or only the primes with primes
+//   binary out : one verdict byte per candidate, or the primes as uint64
+class PrimalityStream {
+private:
+    struct aChunk {
+        uint64_t sequence = 0;
+        vector<uint64_t> candidates;
+        vector<uint8_t> verdicts;
+    };
     
-    // probable prime
-    // Solovay-Strassen primality test
-    bool SolovayStrassenPrimalityTest(int iterations) {
-        if (aN==2 || aN==3)
-            return true;
+    // blocking queue of chunk pointers, never holds more than the chunk count
+    class aQueue {
+    private:
+        mutex aLock;
+        condition_variable aReady;
+        deque<aChunk*> aItems;
+        bool aClosed = false;
         
-        if (aN<2 || aN%2 == 0 || aN%3 == 0)
+    public:
+        void Push(aChunk* chunk) {
+            lock_guard<mutex> guard(aLock);
+            aItems.push_back(chunk);
+            aReady.notify_one();
+        }
+        
+        // nullptr once closed and drained
+        aChunk* Pop() {
+            unique_lock<mutex> guard(aLock);
+            aReady.wait(guard, [&] { return aClosed || !aItems.empty(); });
+            if (aItems.empty())
+                return nullptr;
+            
+            aChunk* chunk = aItems.front();
+            aItems.pop_front();
+            return chunk;
+        }
+        
+        void Close() {
+            lock_guard<mutex> guard(aLock);
+            aClosed = true;
+            aReady.notify_all();
+        }
+    };
+    
+    static const size_t aOutBytes = 1 << 22;
+    
+    bool aBinary = false;
+    bool aPrimesOnly = false;
+    size_t aThreads;
+    size_t aChunkSize = 1 << 16;
+    
+    // input : the whole mapping, or a window refilled from the descriptor
+    int aFd = -1;
+    const uint8_t* aMap = nullptr;
+    size_t aMapBytes = 0;
+    vector<uint8_t> aBuffer;
+    const uint8_t* aPos = nullptr;
+    const uint8_t* aEnd = nullptr;
+    bool aEof = false;
+    bool aReadFailed = false;
+    
+    // keeps the last keep bytes and reads behind them, false at end of input
+    // or on a read error, which also sets aReadFailed
+    bool aRefill(size_t keep) {
+        if (aMap != nullptr || aEof)
             return false;
+        
+        memmove(aBuffer.data(), aPos, keep);
+        ssize_t got;
+        do {
+            got = read(aFd, aBuffer.data() + keep, aBuffer.size() - keep);
+        } while (got < 0 && errno == EINTR);
+        
+        aEof = got <= 0;
+        aReadFailed = aReadFailed || got < 0;
+        aPos = aBuffer.data();
+        aEnd = aPos + keep + max<ssize_t>(got, 0);
+        return !aEof;
+    }
+    
+    // decimal numbers separated by anything else, overflow wraps
+    size_t aReadText(vector<uint64_t>& out) {
+        size_t count = 0;
+        while (count < out.size()) {
+            while (aPos < aEnd && (unsigned)(*aPos - '0') > 9)
+                aPos++;
+            if (aPos == aEnd) {
+                if (!aRefill(0))
+                    break;
+                continue;
+            }
             
-        for (int i=0; i<iterations; i++) {
-            long long a = 2 + rand() % (aN - 3),
-                    jacobi = aPOW(a, (aN-1) / 2, aN);
+            // a number cut by the window is parsed again after the refill
+            const uint8_t* start = aPos;
+            uint64_t n = 0;
+            while (aPos < aEnd && (unsigned)(*aPos - '0') <= 9)
+                n = n * 10 + (*aPos++ - '0');
             
-            if (jacobi == 0 || jacobi != (a%aN))
-                return false;
-                
-            if (jacobi != 1 && jacobi != aN-1)
+            if (aPos == aEnd && aMap == nullptr && !aEof) {
+                aPos = start;
+                aRefill(aEnd - start);
+                continue;
+            }
+            
+            out[count++] = n;
+        }
+        return count;
+    }
+    
+    // trailing bytes short of a record are dropped
+    size_t aReadBinary(vector<uint64_t>& out) {
+        size_t count = 0;
+        while (count < out.size()) {
+            size_t records = min<size_t>((aEnd - aPos) / 8, out.size() - count);
+            memcpy(out.data() + count, aPos, records * 8);
+            aPos += records * 8;
+            count += records;
+            
+            if (count < out.size() && !aRefill(aEnd - aPos))
+                break;
+        }
+        return count;
+    }
+    
+    static char* aFormat(char* out, uint64_t n) {
+        char digits[20];
+        int k = 0;
+        do {
+            digits[k++] = '0' + n % 10;
+            n /= 10;
+        } while (n);
+        
+        while (k)
+            *out++ = digits[--k];
+        return out;
+    }
+    
+    // the output of chunk appended to out
+    void aFormatChunk(vector<char>& out, const aChunk& chunk) {
+        size_t count = chunk.candidates.size();
+        
+        if (aBinary && !aPrimesOnly) {
+            out.insert(out.end(), chunk.verdicts.begin(), chunk.verdicts.end());
+            return;
+        }
+        
+        if (aBinary) {
+            for (size_t i=0; i<count; i++) {
+                const char* bytes = (const char*)&chunk.candidates[i];
+                if (chunk.verdicts[i])
+                    out.insert(out.end(), bytes, bytes + 8);
+            }
+            return;
+        }
+        
+        char line[32];
+        for (size_t i=0; i<count; i++) {
+            if (aPrimesOnly && !chunk.verdicts[i])
+                continue;
+            
+            char* end = aFormat(line, chunk.candidates[i]);
+            if (!aPrimesOnly) {
+                *end++ = ' ';
+                *end++ = '0' + chunk.verdicts[i];
+            }
+            *end++ = '\n';
+            out.insert(out.end(), line, end);
+        }
+    }
+    
+    bool aOpen(const string& path) {
+        if (path.empty() || path == "-") {
+            aFd = STDIN_FILENO;
+        } else {
+            aFd = open(path.c_str(), O_RDONLY);
+            if (aFd < 0)
                 return false;
+            
+            // regular files are mapped, pipes and devices are read
+            struct stat st;
+            if (fstat(aFd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+                void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, aFd, 0);
+                if (map != MAP_FAILED) {
+                    madvise(map, st.st_size, MADV_SEQUENTIAL);
+                    aMap = (const uint8_t*)map;
+                    aMapBytes = st.st_size;
+                    aPos = aMap;
+                    aEnd = aMap + aMapBytes;
+                    return true;
+                }
+            }
         }
         
+        aBuffer.resize(1 << 20);
+        aPos = aEnd = aBuffer.data();
         return true;
     }
+    
+    void aClose() {
+        if (aMap != nullptr)
+            munmap((void*)aMap, aMapBytes);
+        if (aFd >= 0 && aFd != STDIN_FILENO)
+            close(aFd);
+        
+        aFd = -1;
+        aMap = nullptr;
+        aMapBytes = 0;
+        aEof = false;
+        aReadFailed = false;
+    }
+    
+public:
+    PrimalityStream(size_t threads = thread::hardware_concurrency()) {
+        aThreads = max<size_t>(threads, 1);
+    }
+    
+    void SetThreads(size_t threads) {
+        aThreads = max<size_t>(threads, 1);
+    }
+    
+    void SetBinary(bool binary) {
+        aBinary = binary;
+    }
+    
+    void SetPrimesOnly(bool primesOnly) {
+        aPrimesOnly = primesOnly;
+    }
+    
+    void SetChunkSize(size_t chunkSize) {
+        aChunkSize = max<size_t>(chunkSize, 1);
+    }
+    
+    // path "" or "-" is stdin. false with error set if the input can not
+    // be opened or read, or out can not be written, the verdicts written
+    // before the error are in input order
+    bool Run(const string& path, string& error, FILE* out = stdout) {
+        string name = path.empty() || path == "-" ? "stdin" : path;
+        if (!aOpen(path)) {
+            error = "cannot open " + name;
+            return false;
+        }
+        
+        // two chunks per worker keep every stage busy
+        vector<aChunk> chunks(2 * aThreads + 2);
+        aQueue free, work, done;
+        for (aChunk& chunk : chunks) {
+            chunk.candidates.resize(aChunkSize);
+            chunk.verdicts.resize(aChunkSize);
+            free.Push(&chunk);
+        }
+        
+        atomic<bool> writeFailed(false);
+        
+        vector<thread> workers;
+        for (size_t w=0; w<aThreads; w++) {
+            workers.emplace_back([&, w] {
+                PrimalityTest test(w + 1);
+                while (aChunk* chunk = work.Pop()) {
+                    test.BatchPrimalityTest(chunk->candidates, chunk->verdicts);
+                    done.Push(chunk);
+                }
+            });
+        }
+        
+        // writer : completed chunks in input order, after a failed write
+        // the chunks still go back to the reader, which then stops
+        thread writer([&] {
+            vector<char> buffer;
+            buffer.reserve(aOutBytes);
+            auto flush = [&] {
+                if (!writeFailed && fwrite(buffer.data(), 1, buffer.size(), out) != buffer.size())
+                    writeFailed = true;
+                buffer.clear();
+            };
+            
+            vector<aChunk*> pending;
+            uint64_t next = 0;
+            while (aChunk* chunk = done.Pop()) {
+                pending.push_back(chunk);
+                
+                bool progress = true;
+                while (progress) {
+                    progress = false;
+                    for (size_t i=0; i<pending.size(); i++) {
+                        if (pending[i]->sequence != next)
+                            continue;
+                        
+                        if (!writeFailed)
+                            aFormatChunk(buffer, *pending[i]);
+                        if (buffer.size() >= aOutBytes)
+                            flush();
+                        free.Push(pending[i]);
+                        pending[i] = pending.back();
+                        pending.pop_back();
+                        next++;
+                        progress = true;
+                        break;
+                    }
+                }
+            }
+            
+            flush();
+            if (fflush(out) != 0)
+                writeFailed = true;
+        });
+        
+        // reader
+        uint64_t sequence = 0;
+        while (aChunk* chunk = free.Pop()) {
+            if (writeFailed)
+                break;
+            
+            chunk->candidates.resize(aChunkSize);
+            size_t count = aBinary ? aReadBinary(chunk->candidates) : aReadText(chunk->candidates);
+            if (count == 0)
+                break;
+            
+            chunk->candidates.resize(count);
+            chunk->verdicts.resize(count);
+            chunk->sequence = sequence++;
+            work.Push(chunk);
+            
+            if (count < aChunkSize)
+                break;
+        }
+        
+        work.Close();
+        for (thread& worker : workers)
+            worker.join();
+        done.Close();
+        writer.join();
+        
+        bool readFailed = aReadFailed;
+        aClose();
+        if (readFailed)
+            error = "cannot read " + name;
+        else if (writeFailed)
+            error = "cannot write the output";
+        return !readFailed && !writeFailed;
+    }
+};
 
+// Coroutine primality service
+// co_await service.AsyncIsPrime(n) parks the caller in a micro-batch,
+// a batch is flushed to BatchPrimalityTest once it holds aBatchSize requests
+// or its oldest request has waited aDeadline, whichever comes first.
+// the awaiting coroutines are resumed on the service thread, in request order,
+// so a resumed coroutine should hand heavy work back to its own executor.
+class PrimalityService {
+private:
+    struct aRequest {
+        uint64_t n;
+        bool* verdict;
+        coroutine_handle<> caller;
+    };
+    
+    size_t aBatchSize;
+    chrono::steady_clock::duration aDeadline;
+    
+    mutex aLock;
+    condition_variable aWake;
+    vector<aRequest> aPending;
+    chrono::steady_clock::time_point aOldest;
+    bool aStop = false;
+    
+    PrimalityTest aTest;
+    thread aThread;
+    
+    void aSubmit(const aRequest& request) {
+        lock_guard<mutex> guard(aLock);
+        if (aPending.empty())
+            aOldest = chrono::steady_clock::now();
+        aPending.push_back(request);
+        
+        // a new deadline or a full batch, anything else can wait
+        if (aPending.size() == 1 || aPending.size() == aBatchSize)
+            aWake.notify_one();
+    }
+    
+    void aRun() {
+        vector<aRequest> batch;
+        vector<uint64_t> candidates;
+        vector<uint8_t> verdicts;
+        
+        unique_lock<mutex> guard(aLock);
+        while (true) {
+            if (aPending.empty()) {
+                if (aStop)
+                    return;
+                aWake.wait(guard);
+                continue;
+            }
+            
+            chrono::steady_clock::time_point due = aOldest + aDeadline;
+            if (!aStop && aPending.size() < aBatchSize && chrono::steady_clock::now() < due) {
+                aWake.wait_until(guard, due);
+                continue;
+            }
+            
+            batch.swap(aPending);
+            guard.unlock();
+            
+            candidates.resize(batch.size());
+            verdicts.resize(batch.size());
+            for (size_t i=0; i<batch.size(); i++)
+                candidates[i] = batch[i].n;
+            aTest.BatchPrimalityTest(candidates, verdicts);
+            
+            for (size_t i=0; i<batch.size(); i++) {
+                *batch[i].verdict = verdicts[i];
+                batch[i].caller.resume();
+            }
+            batch.clear();
+            
+            guard.lock();
+        }
+    }
+    
+public:
+    class Awaiter {
+    private:
+        PrimalityService* aService;
+        uint64_t aN;
+        bool aVerdict = false;
+        
+    public:
+        Awaiter(PrimalityService* service, uint64_t n) : aService(service), aN(n) {}
+        
+        bool await_ready() const {
+            return false;
+        }
+        
+        // the service may resume the caller before this returns,
+        // nothing of the awaiter is touched after the request is queued
+        void await_suspend(coroutine_handle<> caller) {
+            aService->aSubmit({aN, &aVerdict, caller});
+        }
+        
+        bool await_resume() const {
+            return aVerdict;
+        }
+    };
+    
+    PrimalityService(size_t batchSize = 1024,
+            chrono::steady_clock::duration deadline = chrono::microseconds(200)) {
+        aBatchSize = max<size_t>(batchSize, 1);
+        aDeadline = deadline;
+        aThread = thread([this] { aRun(); });
+    }
+    
+    // requests still queued are answered before the thread exits
+    ~PrimalityService() {
+        {
+            lock_guard<mutex> guard(aLock);
+            aStop = true;
+        }
+        aWake.notify_one();
+        aThread.join();
+    }
+    
+    PrimalityService(const PrimalityService&) = delete;
+    PrimalityService& operator=(const PrimalityService&) = delete;
+    
+    Awaiter AsyncIsPrime(uint64_t n) {
+        return Awaiter(this, n);
+    }
 };
 
-int main() {
-    srand(time(0));
+int main(int argc, char** argv) {
+    // --stream [--binary] [--primes] [--threads N] [--chunk N] [file]
+    if (argc > 1 && string(argv[1]) == "--stream") {
+        PrimalityStream stream;
+        string path;
+        for (int i=2; i<argc; i++) {
+            string arg = argv[i];
+            if (arg == "--binary")
+                stream.SetBinary(true);
+            else if (arg == "--primes")
+                stream.SetPrimesOnly(true);
+            else if (arg == "--threads" && i + 1 < argc)
+                stream.SetThreads(strtoull(argv[++i], nullptr, 10));
+            else if (arg == "--chunk" && i + 1 < argc)
+                stream.SetChunkSize(strtoull(argv[++i], nullptr, 10));
+            else
+                path = arg;
+        }
+        
+        string error;
+        if (!stream.Run(path, error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        return 0;
+    }
+    
+    // --verify [--baseline file] [--record file] [--tolerance x] [--pseudoprimes file]
+    if (argc > 1 && string(argv[1]) == "--verify") {
+        PrimalityVerify verify;
+        string record;
+        for (int i=2; i+1<argc; i+=2) {
+            string arg = argv[i], value = argv[i + 1];
+            bool ok = true;
+            if (arg == "--baseline")
+                ok = verify.LoadBaseline(value);
+            else if (arg == "--record")
+                record = value;
+            else if (arg == "--tolerance")
+                verify.SetTolerance(strtod(value.c_str(), nullptr));
+            else if (arg == "--pseudoprimes")
+                ok = verify.LoadPseudoprimes(value);
+            
+            if (!ok) {
+                fprintf(stderr, "cannot open %s\n", value.c_str());
+                return 1;
+            }
+        }
+        
+        int failures = verify.Run();
+        if (!record.empty() && !verify.SaveBaseline(record)) {
+            fprintf(stderr, "cannot write %s\n", record.c_str());
+            return 1;
+        }
+        return failures != 0;
+    }
+    
+    if (argc > 1 && string(argv[1]) == "--profile") {
+        PrimalityProfile profile;
+        if (!profile.Open())
+            fprintf(stderr, "perf_event_open unavailable: %s, wall clock only\n", profile.Error());
+        profile.Run();
+        return 0;
+    }
+    
+    // --shard plan L R chunks
+    // --shard run L R chunks [--pi] [--node k] [--nodes n] [--out file]
+    // --shard merge [--out file] files
+    if (argc > 2 && string(argv[1]) == "--shard") {
+        string mode = argv[2], out = "shards.bin";
+        vector<string> args;
+        ShardResult::Kind kind = ShardResult::Sieve;
+        uint64_t node = 0, nodes = 1;
+        for (int i=3; i<argc; i++) {
+            string arg = argv[i];
+            if (arg == "--pi")
+                kind = ShardResult::Pi;
+            else if (arg == "--node" && i + 1 < argc)
+                node = strtoull(argv[++i], nullptr, 10);
+            else if (arg == "--nodes" && i + 1 < argc)
+                nodes = strtoull(argv[++i], nullptr, 10);
+            else if (arg == "--out" && i + 1 < argc)
+                out = argv[++i];
+            else
+                args.push_back(arg);
+        }
+        
+        string error;
+        if (mode == "merge") {
+            ShardResult merged;
+            vector<pair<uint64_t, uint64_t>> gaps;
+            if (!PrimeShards::Merge(args, merged, gaps, error)) {
+                fprintf(stderr, "%s\n", error.c_str());
+                return 1;
+            }
+            
+            printf("[%llu, %llu) %s primes %llu checksum %016llx first %llu last %llu max gap %llu\n",
+                    (unsigned long long)merged.lo, (unsigned long long)merged.hi,
+                    merged.kind == ShardResult::Pi ? "pi" : "sieve", (unsigned long long)merged.count,
+                    (unsigned long long)merged.checksum, (unsigned long long)merged.first,
+                    (unsigned long long)merged.last, (unsigned long long)merged.maxGap);
+            for (auto [a, b]: gaps)
+                printf("missing [%llu, %llu)\n", (unsigned long long)a, (unsigned long long)b);
+            
+            FILE* file = fopen(out.c_str(), "wb");
+            bool ok = file && fwrite(&merged, sizeof(merged), 1, file) == 1;
+            if (!file || fclose(file) != 0 || !ok) {
+                fprintf(stderr, "cannot write %s\n", out.c_str());
+                return 1;
+            }
+            return !gaps.empty();
+        }
+        
+        if (args.size() != 3 || (mode != "plan" && mode != "run") || nodes == 0 || node >= nodes) {
+            fprintf(stderr, "usage : --shard plan|run L R chunks [--pi] [--node k] [--nodes n], k < n\n");
+            return 1;
+        }
+        
+        uint64_t lo = strtoull(args[0].c_str(), nullptr, 10),
+                hi = strtoull(args[1].c_str(), nullptr, 10),
+                chunks = strtoull(args[2].c_str(), nullptr, 10);
+        if (mode == "plan") {
+            vector<pair<uint64_t, uint64_t>> plan = PrimeShards::Plan(lo, hi, chunks);
+            for (size_t i=0; i<plan.size(); i++)
+                printf("%zu %llu %llu\n", i, (unsigned long long)plan[i].first, (unsigned long long)plan[i].second);
+            return 0;
+        }
+        
+        auto progress = [](size_t i, const ShardResult& r) {
+            fprintf(stderr, "chunk %zu [%llu, %llu) : %llu primes\n", i,
+                    (unsigned long long)r.lo, (unsigned long long)r.hi, (unsigned long long)r.count);
+        };
+        if (!PrimeShards::Run(lo, hi, chunks, kind, node, nodes, out, error, progress)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        return 0;
+    }
+    
+    if (argc > 1 && string(argv[1]) == "--bench") {
+        PrimalityBenchmark().Run();
+#if defined(PRIMALITY_STATS)
+        PrimalityStats::Read().Print();
+#endif
+        return 0;
+    }
     
-    PrimalityTest a = PrimalityTest();
+    PrimalityTest a = PrimalityTest(time(0));
     a.SetTestNumber(4158);
     cout << "Test " << a.GetTestNumber() << endl;
     cout << a.FermatsPrimalityTest();